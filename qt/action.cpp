@@ -1,8 +1,10 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
 #include <QAbstractButton>
+#include <QAbstractScrollArea>
 #include <QClipboard>
 #include <QComboBox>
 #include <QContextMenuEvent>
+#include <QDockWidget>
 #include <QGroupBox>
 #include <QGuiApplication>
 #include <QLabel>
@@ -11,8 +13,10 @@
 #include <QListView>
 #include <QMenu>
 #include <QMenuBar>
+#include <QSplitter>
 #include <QTabWidget>
 #include <QTextEdit>
+#include <QToolBar>
 #include <QTreeView>
 #include <QWidget>
 #include <cstring>
@@ -22,6 +26,7 @@
 #include <algorithm>
 #include <iterator>
 #include <map>
+#include <vector>
 
 #include "action.h"
 #include "actionmacros.h"
@@ -30,6 +35,7 @@
 #include "hint.h"
 #include "logging.h"
 #include "overlay.h"
+#include "usage.h"
 
 using std::map;
 
@@ -82,12 +88,76 @@ void BaseAction::accept(QWidgetActionProxy *proxy) {
     finish();
 }
 
-void BaseAction::act() {
+QList<QWidgetActionProxy *> BaseAction::discover() {
+  discoveryGeneration = Controller::instance()->uiGeneration();
   QList<QWidgetActionProxy *> hintData;
-  // get the hints
   const QMetaObject *targetMO = p_currentRoot->metaObject();
   auto metadata = getMetadataForMetaObject(targetMO);
   metadata.staticMethods->hintGeneric(this, p_currentRoot, hintData);
+  return hintData;
+}
+
+// Sort the proxies so that the most important ones come first and get the
+// shortest codes: top to bottom and left to right, or nearest to the focus.
+static void orderByImportance(QList<QWidgetActionProxy *> &proxies,
+                              QWidget *root, HintOrdering ordering) {
+  if (ordering == DiscoveryOrder)
+    return;
+
+  struct Ranked {
+    qint64 distance;
+    QPoint position;
+    QWidgetActionProxy *proxy;
+  };
+  WidgetOffsetTable offsets(root);
+  QWidget *focus = QApplication::focusWidget();
+  bool nearFocus = ordering == FocusProximityOrder && focus != nullptr;
+  QPoint focusPoint = nearFocus ? offsets.offset(focus) + focus->rect().center()
+                                : QPoint();
+
+  std::vector<Ranked> ranked;
+  ranked.reserve(proxies.length());
+  for (QWidgetActionProxy *proxy : proxies) {
+    QPoint position = offsets.offset(proxy->widget) + proxy->positionInWidget;
+    QPoint delta = position - focusPoint;
+    qint64 distance = nearFocus ? qint64(delta.x()) * delta.x() +
+                                      qint64(delta.y()) * delta.y()
+                                : 0;
+    ranked.push_back({distance, position, proxy});
+  }
+  std::stable_sort(ranked.begin(), ranked.end(),
+                   [](const Ranked &a, const Ranked &b) {
+                     if (a.distance != b.distance)
+                       return a.distance < b.distance;
+                     if (a.position.y() != b.position.y())
+                       return a.position.y() < b.position.y();
+                     return a.position.x() < b.position.x();
+                   });
+  for (size_t i = 0; i != ranked.size(); ++i)
+    proxies[i] = ranked[i].proxy;
+}
+
+// Weights of the proxies by how often they were accepted, or none if none was
+static QVector<double>
+usageWeights(const QList<QWidgetActionProxy *> &proxies) {
+  QVector<double> weights;
+  UsageTable *usage = UsageTable::instance();
+  if (!Controller::settings.usageWeightedHints || usage->size() == 0)
+    return weights;
+  bool used = false;
+  weights.reserve(proxies.length());
+  for (QWidgetActionProxy *proxy : proxies) {
+    double count = usage->weight(usageKey(proxy));
+    used = used || count > 0;
+    weights.append(1.0 + count);
+  }
+  if (!used)
+    weights.clear();
+  return weights;
+}
+
+void BaseAction::act() {
+  QList<QWidgetActionProxy *> hintData = discover();
 
   // Nothing hintable. End the action
   if (hintData.length() == 0) {
@@ -98,18 +168,73 @@ void BaseAction::act() {
   }
   Overlay *overlay = windowController->findOverlayForWidget(p_currentRoot);
 
-  HintGenerator hintStringGenerator(Controller::settings.hintChars,
-                                    hintData.length());
-  for (QWidgetActionProxy *actionProxy : hintData) {
-    string hintStr = *hintStringGenerator;
-    logDebug << "Hinting " << actionProxy->widget << " with "
-             << QString::fromStdString(hintStr);
-    overlay->addHint(QString::fromStdString(*hintStringGenerator), actionProxy);
-    hintStringGenerator++;
+  // filtered hinting relabels the matches in discovery order anyway, and
+  // needs all of them to match against
+  if (windowController->isFiltering()) {
+    candidates.clear();
+    overlay->addHints(hintData, Controller::settings.filteredHintChars);
+    overlay->startTextFilter();
+    return;
   }
+  candidates = hintData;
+  if (pageCount() > 1)
+    orderByImportance(candidates, p_currentRoot, FocusProximityOrder);
+  showPage(0);
+}
+
+int BaseAction::pageCount() {
+  int perPage = Controller::settings.maxHintsPerPage;
+  if (perPage <= 0 || candidates.isEmpty())
+    return 1;
+  return (candidates.length() + perPage - 1) / perPage;
+}
+
+// Labels are made for the candidates of the page only, so that their number
+// and the length of the codes are bounded
+void BaseAction::showPage(int index) {
+  Overlay *overlay = windowController->findOverlayForWidget(p_currentRoot);
+  int perPage = Controller::settings.maxHintsPerPage;
+  QList<QWidgetActionProxy *> pageData =
+      pageCount() > 1 ? candidates.mid(index * perPage, perPage) : candidates;
+  pageData.removeAll(nullptr);
+  page = index;
+  overlay->clear();
+  orderByImportance(pageData, p_currentRoot,
+                    Controller::settings.hintOrdering);
+  overlay->addHints(pageData, Controller::settings.hintChars,
+                    usageWeights(pageData));
   overlay->resetSelection();
 }
 
+// Pages emptied by continuous hinting are skipped
+void BaseAction::nextPage() {
+  int pages = pageCount();
+  if (pages <= 1)
+    return;
+  int next = (page + 1) % pages;
+  while (next != page && isPageEmpty(next))
+    next = (next + 1) % pages;
+  showPage(next);
+  logInfo << "Showing page" << page + 1 << "of" << pages << "of" << this;
+}
+
+bool BaseAction::isPageEmpty(int index) {
+  int perPage = Controller::settings.maxHintsPerPage;
+  QList<QWidgetActionProxy *> pageData =
+      pageCount() > 1 ? candidates.mid(index * perPage, perPage) : candidates;
+  return pageData.count(nullptr) == pageData.length();
+}
+
+void BaseAction::removeCandidate(QWidgetActionProxy *proxy) {
+  int i = candidates.indexOf(proxy);
+  if (i >= 0)
+    candidates[i] = nullptr;
+}
+
+bool BaseAction::hasCandidates() {
+  return candidates.count(nullptr) != candidates.length();
+}
+
 // ActivateAction
 
 ActivateAction::ActivateAction(WindowController *controller)
@@ -148,6 +273,62 @@ MenuBarAction::MenuBarAction(WindowController *controller)
   // For menu actions
 }
 
+// RegionAction
+
+RegionAction::RegionAction(WindowController *controller)
+    : ActivateAction(controller) {}
+
+static bool isRegion(QWidget *w) {
+  return qobject_cast<QDockWidget *>(w) || qobject_cast<QToolBar *>(w) ||
+         qobject_cast<QTabWidget *>(w) ||
+         qobject_cast<QAbstractScrollArea *>(w) ||
+         qobject_cast<QSplitter *>(w->parentWidget());
+}
+
+// The outermost regions under widget, in the order of the widget tree.
+// Floating docks are windows of their own.
+static void findRegions(QWidget *widget, QList<QWidget *> &regions) {
+  for (QObject *child : widget->children()) {
+    QWidget *w = qobject_cast<QWidget *>(child);
+    if (w == nullptr || w->isWindow() || isTetradactylObject(w) ||
+        qobject_cast<QSplitterHandle *>(w) ||
+        !QWidgetActionProxy::visible(w))
+      continue;
+    if (isRegion(w))
+      regions.append(w);
+    else
+      findRegions(w, regions);
+  }
+}
+
+void RegionAction::act() {
+  if (!choosingRegion) {
+    BaseAction::act();
+    return;
+  }
+  QList<QWidget *> regions;
+  findRegions(p_currentRoot, regions);
+  // nothing to narrow down
+  if (regions.length() < 2) {
+    choosingRegion = false;
+    BaseAction::act();
+    return;
+  }
+  candidates.clear();
+  for (QWidget *region : regions)
+    candidates.append(new QWidgetActionProxy(region));
+  showPage(0);
+}
+
+void RegionAction::accept(QWidgetActionProxy *proxy) {
+  if (!choosingRegion) {
+    BaseAction::accept(proxy);
+    return;
+  }
+  choosingRegion = false;
+  addNextStage(proxy->widget);
+}
+
 // ContextMenuAction
 
 ContextMenuAction::ContextMenuAction(WindowController *controller)
@@ -239,6 +420,39 @@ QWidgetActionProxy::createForMetaObject(const QMetaObject *widgetMO,
   return reinterpret_cast<QWidgetActionProxy *>(obj);
 }
 
+QWidgetActionProxy *
+QWidgetActionProxy::createForObjectPath(const ObjectPathTarget &target) {
+  QWidget *w = target.widget;
+  if (w == nullptr)
+    return nullptr;
+  if (target.tab >= 0) {
+    QTabBar *bar = qobject_cast<QTabBar *>(w);
+    QPoint position = bar->tabRect(target.tab).topLeft();
+    return new QTabBarActionProxy(target.tab, position, bar);
+  }
+  if (target.index.isValid()) {
+    QAbstractItemView *view = qobject_cast<QAbstractItemView *>(w);
+    QPoint position = view->visualRect(target.index).topLeft();
+    if (qobject_cast<QTreeView *>(w))
+      return new QTreeViewActionProxy(target.index, position, w);
+    if (qobject_cast<QListView *>(w))
+      return new QListViewActionProxy(target.index, position, w);
+    return new QTableViewActionProxy(target.index, position, w);
+  }
+  if (target.action != nullptr) {
+    QMenu *menu = qobject_cast<QMenu *>(w);
+    if (menu != nullptr)
+      return new QMenuActionProxy(
+          menu, menu->actionGeometry(target.action).topLeft(), target.action);
+    QMenuBar *bar = qobject_cast<QMenuBar *>(w);
+    if (bar != nullptr)
+      return new QMenuBarActionProxy(
+          bar, bar->actionGeometry(target.action).topLeft(), target.action);
+    return nullptr;
+  }
+  return createForMetaObject(w->metaObject(), w);
+}
+
 // QWidgetActionProxy
 
 bool QWidgetActionProxyStatic::isHintableGeneric(BaseAction *action,
@@ -421,6 +635,18 @@ bool QWidgetActionProxy::contextMenu(ContextMenuAction *action) {
   return true;
 }
 
+// Most widgets expose their text in one of these properties
+QString QWidgetActionProxy::text() {
+  for (const char *name : {"text", "title", "currentText", "windowTitle"}) {
+    QVariant value = widget->property(name);
+    if (value.isValid() && !value.toString().isEmpty())
+      return value.toString();
+  }
+  return widget->accessibleName();
+}
+
+QString QWidgetActionProxy::objectPath() { return widgetPath(widget); }
+
 // QAbstractButtonActionProxy
 
 bool QAbstractButtonActionProxy::activate(ActivateAction *action) {
@@ -536,6 +762,15 @@ void QMenuBarActionProxyStatic::hintMenuable(
   }
 }
 
+// without the mnemonic marker
+QString QMenuBarActionProxy::text() {
+  return QString(menuAction->text()).remove(QLatin1Char('&'));
+}
+
+QString QMenuBarActionProxy::objectPath() {
+  return actionPath(widget, menuAction);
+}
+
 bool QMenuBarActionProxy::menu(MenuBarAction *tetradactylAction) {
   QOBJECT_CAST_ASSERT(QMenuBar, widget);
   QMenu *menu = menuAction->menu();
@@ -569,6 +804,14 @@ void QMenuActionProxyStatic::hintMenuable(
   }
 }
 
+QString QMenuActionProxy::text() {
+  return QString(menuAction->text()).remove(QLatin1Char('&'));
+}
+
+QString QMenuActionProxy::objectPath() {
+  return actionPath(widget, menuAction);
+}
+
 bool QMenuActionProxy::menu(MenuBarAction *tetradactylAction) {
   QOBJECT_CAST_ASSERT(QMenu, widget);
   QMenu *submenu = menuAction->menu();
@@ -705,6 +948,16 @@ bool QTabBarActionProxy::activate(ActivateAction *action) {
   return true;
 }
 
+QString QTabBarActionProxy::text() {
+  QOBJECT_CAST_ASSERT(QTabBar, widget);
+  return instance->tabText(tabIndex);
+}
+
+QString QTabBarActionProxy::objectPath() {
+  QOBJECT_CAST_ASSERT(QTabBar, widget);
+  return tabPath(instance, tabIndex);
+}
+
 bool QTabBarActionProxy::yank(YankAction *action) {
   QOBJECT_CAST_ASSERT(QTabBar, widget);
   QClipboard *clipboard = QGuiApplication::clipboard();
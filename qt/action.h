@@ -18,6 +18,7 @@
 
 #include "actionmacros.h"
 #include "common.h"
+#include "objectpath.h"
 
 using std::map;
 
@@ -48,6 +49,13 @@ public:
   QWidget *currentRoot();
 
   static BaseAction *createActionByHintMode(HintMode, WindowController *);
+  // whether the UI changed since the last discovery
+  bool isStale();
+  int pageCount();
+  int currentPage();
+  // Leave the candidate out of the pages, which keep their bounds
+  void removeCandidate(QWidgetActionProxy *proxy);
+  bool hasCandidates();
 public slots:
   virtual void accept(QWidgetActionProxy *proxy);
   void addNextStage(QWidget *root);
@@ -55,6 +63,12 @@ public slots:
   void finish();
 
   virtual void act();
+  void nextPage();
+
+protected:
+  QList<QWidgetActionProxy *> discover();
+  void showPage(int page);
+  bool isPageEmpty(int page);
 
 public:
   HintMode mode;
@@ -71,12 +85,23 @@ protected:
   // WindowController. That's the default. In the case of multi-step actions, it
   // may point to a QMenu Overlay
   QWidget *p_currentRoot;
+  // Candidates of the current stage. Only those of the current page have
+  // labels when there are more than ControllerSettings::maxHintsPerPage.
+  // Removed candidates are null.
+  QList<QWidgetActionProxy *> candidates;
+  int page = 0;
+  // Controller::uiGeneration() at the last discovery
+  quint64 discoveryGeneration = 0;
 };
 
 inline bool BaseAction::isDone() { return done; }
+inline int BaseAction::currentPage() { return page; }
 inline void BaseAction::setDone(bool _done) { done = _done; }
 inline void BaseAction::finish() { setDone(true); }
 inline QWidget *BaseAction::currentRoot() { return p_currentRoot; }
+inline bool BaseAction::isStale() {
+  return discoveryGeneration != Controller::instance()->uiGeneration();
+}
 inline ControllerMode BaseAction::controllerModeAfterSuccess() {
   return p_controllerModeAfterSuccess;
 }
@@ -133,6 +158,23 @@ public:
   QList<QMenu *> menusToClose;
 };
 
+// Region-first activation for dense windows. The first stage hints the large
+// regions of the window: docks, tool bars, tab widgets, scroll areas and the
+// panes of splitters. The second stage hints the activatable widgets inside
+// the chosen region, and its discovery walks only the region's subtree.
+class RegionAction : public ActivateAction {
+  Q_OBJECT
+public:
+  RegionAction(WindowController *controller);
+  virtual ~RegionAction() {}
+
+  void act() override;
+  void accept(QWidgetActionProxy *proxy) override;
+
+private:
+  bool choosingRegion = true;
+};
+
 // Widget Proxies
 
 // A speculative idea: The action-specific code is accompanoed by an
@@ -231,9 +273,16 @@ public:
   }
   virtual bool menu(MenuBarAction *action) { return false; }
   virtual bool contextMenu(ContextMenuAction *action);
+  // visible text of the hinted (pseudo-)widget, matched in filtered hinting
+  virtual QString text();
+  // stable name of the hinted (pseudo-)widget, see objectpath.h
+  virtual QString objectPath();
 
   static QWidgetActionProxy *createForMetaObject(const QMetaObject *mo,
                                                  QWidget *w);
+  // the proxy discovery would make for the target
+  static QWidgetActionProxy *
+  createForObjectPath(const ObjectPathTarget &target);
 
   QWidget *widget;
   QPoint positionInWidget;
@@ -342,6 +391,8 @@ public:
   virtual ~QMenuBarActionProxy() {}
 
   bool menu(MenuBarAction *action) override;
+  QString text() override;
+  QString objectPath() override;
 
 protected:
   QAction *menuAction;
@@ -364,6 +415,8 @@ public:
   virtual ~QMenuActionProxy() {}
 
   bool menu(MenuBarAction *action) override;
+  QString text() override;
+  QString objectPath() override;
 
 protected:
   QAction *menuAction;
@@ -391,6 +444,8 @@ public:
 
   bool activate(ActivateAction *action) override;
   bool yank(YankAction *action) override;
+  QString text() override;
+  QString objectPath() override;
 
 protected:
   int tabIndex;
@@ -452,6 +507,8 @@ public:
 
   virtual bool edit(EditAction *action) override;
   virtual bool focus(FocusAction *action) override;
+  QString text() override;
+  QString objectPath() override;
 
 protected:
   QModelIndex modelIndex;
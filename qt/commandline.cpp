@@ -1,24 +1,40 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QAction>
+#include <QKeyEvent>
 #include <QLineEdit>
+#include <QPointer>
+#include <QTimer>
 #include <QWidget>
 
 #include "commandline.h"
 #include "common.h"
 #include "controller.h"
+#include "palette.h"
 
 namespace Tetradactyl {
 
-CommandLine::CommandLine(QWidget *parent) : QLineEdit(parent), p_isOpen(false) {
+const QChar CommandLine::palettePrefix = QLatin1Char('>');
+
+CommandLine::CommandLine(QWidget *parent)
+    : QLineEdit(parent), p_isOpen(false), p_palette(nullptr) {
   setStyleSheet(promptStylesheet);
 
+  connect(this, &CommandLine::textChanged, this, &CommandLine::updatePalette);
   connect(this, &CommandLine::returnPressed, this, [this] {
     QString cmdline = text();
+    // the action runs once the command line is gone, as a command does
+    QPointer<QAction> action =
+        isPaletteOpen() ? p_palette->selectedAction() : nullptr;
     setText("");
-    tetradactyl->executeCommand(cmdline);
+    // closed before the command runs, which may open it again, as :palette
+    setOpened(false);
+    if (cmdline.startsWith(palettePrefix)) {
+      if (action)
+        QTimer::singleShot(0, action.data(), &QAction::trigger);
+    } else {
+      tetradactyl->executeCommand(cmdline);
+    }
     emit accepted(cmdline);
-
-    hide();
-    emit closed();
   });
 
   hide();
@@ -26,17 +42,50 @@ CommandLine::CommandLine(QWidget *parent) : QLineEdit(parent), p_isOpen(false) {
 
 void CommandLine::open() { setOpened(true); }
 
+void CommandLine::openPalette() {
+  setOpened(true);
+  setText(palettePrefix);
+}
+
+bool CommandLine::isPaletteOpen() {
+  return p_palette != nullptr && p_palette->isVisible();
+}
+
+// The palette sits right above the command line, as wide as it is
+void CommandLine::updatePalette(const QString &text) {
+  if (!text.startsWith(palettePrefix)) {
+    if (p_palette != nullptr)
+      p_palette->hide();
+    return;
+  }
+  if (p_palette == nullptr)
+    p_palette = new Palette(parentWidget());
+  p_palette->setQuery(text.mid(1));
+  p_palette->setFixedWidth(width());
+  p_palette->adjustSize();
+  p_palette->move(x(), y() - p_palette->height());
+  p_palette->raise();
+}
+
 void CommandLine::setOpened(bool nowOpened) {
   bool changed = (nowOpened != p_isOpen);
   p_isOpen = nowOpened;
   if (nowOpened) {
+    // the overlay may have to be shown first for the command line to be
+    if (changed)
+      emit opened();
     show();
     setFocus();
   } else {
+    // The focus isn't handed on to the next widget, so that the window is
+    // back in Normal mode for the command to run in
+    if (hasFocus())
+      clearFocus();
     hide();
-  }
-  if (changed) {
-    emit nowOpened ? opened() : closed();
+    if (p_palette != nullptr)
+      p_palette->hide();
+    if (changed)
+      emit closed();
   }
 }
 
@@ -50,6 +99,19 @@ void CommandLine::focusInEvent(QFocusEvent *ev) {
   QLineEdit::focusInEvent(ev);
 }
 
+// Up and down move the selection of the palette
+void CommandLine::keyPressEvent(QKeyEvent *ev) {
+  if (isPaletteOpen() && ev->key() == Qt::Key_Up) {
+    p_palette->moveSelection(1);
+    return;
+  }
+  if (isPaletteOpen() && ev->key() == Qt::Key_Down) {
+    p_palette->moveSelection(-1);
+    return;
+  }
+  QLineEdit::keyPressEvent(ev);
+}
+
 void CommandLine::reportError() {
   // TODO 02/10/20 psacawa: report error in prompt?
 }
@@ -5,6 +5,7 @@
 namespace Tetradactyl {
 
 class Overlay;
+class Palette;
 
 class CommandLine : public QLineEdit {
   Q_OBJECT
@@ -18,9 +19,13 @@ public:
 
   void focusOutEvent(QFocusEvent *) override;
   void focusInEvent(QFocusEvent *) override;
+  void keyPressEvent(QKeyEvent *) override;
   void reportError();
 
   QSize minimumSizeHint() const override;
+  // a command line starting with this searches the actions of the window
+  static const QChar palettePrefix;
+  Palette *actionPalette();
 
 signals:
   // This doesn't guarantee that this was a valid command line
@@ -30,12 +35,18 @@ signals:
 
 public slots:
   void open();
+  void openPalette();
 
 private:
+  void updatePalette(const QString &text);
+  bool isPaletteOpen();
+
   bool p_isOpen;
+  Palette *p_palette;
 };
 
 inline bool CommandLine::isOpen() { return p_isOpen; }
+inline Palette *CommandLine::actionPalette() { return p_palette; }
 
 inline QSize CommandLine::minimumSizeHint() const {
   QSize ret = QLineEdit::minimumSizeHint();
@@ -1,13 +1,16 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QApplication>
 #include <QDebug>
 #include <QLoggingCategory>
 #include <QMap>
 #include <QMessageBox>
 #include <QTimer>
 
+#include "commandline.h"
 #include "commands.h"
 #include "controller.h"
 #include "logging.h"
+#include "overlay.h"
 
 LOGGING_CATEGORY_COLOR("tetradactyl.commands", Qt::cyan);
 
@@ -19,6 +22,51 @@ bool reset(QList<QString> argv) {
   return true;
 }
 
+// Report memory held by overlays which aren't showing hints
+bool overlays(QList<QString> argv) {
+  size_t totalBytes = 0;
+  for (auto winController : tetradactyl->windows()) {
+    size_t bytes = winController->idleOverlayBytes();
+    logInfo << winController << "has" << winController->overlays().length()
+            << "overlays and" << winController->pooledOverlays()
+            << "pooled, idle:" << bytes / 1024 << "KiB";
+    totalBytes += bytes;
+  }
+  logInfo << "Idle overlays hold about" << totalBytes / 1024 << "KiB";
+  return true;
+}
+
+// Accept the target of the last hinting again, in the active window
+bool repeat(QList<QString> argv) {
+  WindowController *controller =
+      tetradactyl->findControllerForWidget(qApp->activeWindow());
+  if (controller == nullptr)
+    return false;
+  controller->repeatLastAccept();
+  return true;
+}
+
+// Replay the macro in the register, optionally a number of times
+bool replay(QList<QString> argv) {
+  WindowController *controller =
+      tetradactyl->findControllerForWidget(qApp->activeWindow());
+  if (controller == nullptr || argv.length() < 2 || argv.at(1).length() != 1)
+    return false;
+  int count = argv.length() > 2 ? qMax(1, argv.at(2).toInt()) : 1;
+  controller->replayMacro(argv.at(1).at(0), count);
+  return true;
+}
+
+// Open the command line of the active window on the action palette
+bool palette(QList<QString> argv) {
+  WindowController *controller =
+      tetradactyl->findControllerForWidget(qApp->activeWindow());
+  if (controller == nullptr)
+    return false;
+  controller->mainOverlay()->commandLine()->openPalette();
+  return true;
+}
+
 struct Command {
   QString argv0;
   QString description;
@@ -29,7 +77,15 @@ struct Command {
   { argv0, {argv0, description, func}, }
 
 static QMap<QString, Command> commandRegistry = {
-    DEFINE_COMMAND("reset", "reset Tetradactyl", reset)};
+    DEFINE_COMMAND("reset", "reset Tetradactyl", reset),
+    DEFINE_COMMAND("overlays", "report memory held by idle overlays",
+                   overlays),
+    DEFINE_COMMAND("repeat", "accept the target of the last hinting again",
+                   repeat),
+    DEFINE_COMMAND("replay", "replay the macro of a register [count] times",
+                   replay),
+    DEFINE_COMMAND("palette", "search and trigger the actions of the window",
+                   palette)};
 
 void runCommand(QList<QString> argv) {
   Q_ASSERT(argv.length() > 0);
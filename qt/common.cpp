@@ -14,7 +14,8 @@ namespace Tetradactyl {
 
 static QSet<const QMetaObject *> tetradactylMetaObjects = {
     &HintLabel::staticMetaObject, &Overlay::staticMetaObject,
-    &Controller::staticMetaObject, &WindowController::staticMetaObject};
+    &OverlaySurface::staticMetaObject, &Controller::staticMetaObject,
+    &WindowController::staticMetaObject};
 
 bool isTetradactylMetaObject(const QMetaObject *mo) {
   return tetradactylMetaObjects.contains(mo);
@@ -38,7 +39,8 @@ bool isDescendantOf(QObject *descendant, QObject *ancestor) {
 bool isTetradactylWindow(QWidget *w) {
   QList<Qt::WindowType> windowTypes = {Qt::WindowType::Window,
                                        Qt::WindowType::Dialog};
-  return w->isWindow() && windowTypes.contains(w->windowType());
+  return w->isWindow() && windowTypes.contains(w->windowType()) &&
+         !isTetradactylObject(w);
 }
 
 // Widget can have an Tetradactyl::Overlay attached to it; essentially
@@ -61,6 +63,25 @@ QWidget *getToplevelWidgetForWindow(QWindow *win) {
   Q_UNREACHABLE();
 }
 
+WidgetOffsetTable::WidgetOffsetTable(QWidget *_root) : root(_root) {}
+
+QPoint WidgetOffsetTable::offset(QWidget *w) {
+  if (w == root)
+    return QPoint(0, 0);
+  auto search = offsets.constFind(w);
+  if (search != offsets.constEnd())
+    return search.value();
+  QPoint ret;
+  QWidget *parent = w->parentWidget();
+  // popups and other windows aren't positioned relative to their parent
+  if (w->isWindow() || parent == nullptr)
+    ret = root->mapFromGlobal(w->mapToGlobal(QPoint(0, 0)));
+  else
+    ret = offset(parent) + w->pos();
+  offsets.insert(w, ret);
+  return ret;
+}
+
 const char promptStylesheet[] =
     "* { background-color: #444; color: white; font-family: Monospace; "
     " padding: 1px; }";
@@ -1,6 +1,7 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
 #pragma once
 
+#include <QHash>
 #include <QMetaEnum>
 #include <QMetaObject>
 #include <QModelIndex>
@@ -32,6 +33,23 @@ template <typename C> C findAncestor(QObject *obj) {
   return nullptr;
 }
 
+// Memoized offsets of widgets relative to a common root. Widgets sharing
+// ancestors share the walk up the parent chain, so positioning n hints costs
+// O(n) rather than O(n * depth). Must be cleared when the widgets move.
+class WidgetOffsetTable {
+public:
+  WidgetOffsetTable(QWidget *root);
+
+  QPoint offset(QWidget *w);
+  void clear();
+
+private:
+  QWidget *root;
+  QHash<QWidget *, QPoint> offsets;
+};
+
+inline void WidgetOffsetTable::clear() { offsets.clear(); }
+
 extern const char promptStylesheet[];
 
 } // namespace Tetradactyl
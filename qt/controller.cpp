@@ -1,6 +1,7 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
 #include <QAbstractButton>
 #include <QAction>
+#include <QActionEvent>
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
@@ -13,7 +14,6 @@
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QPointer>
-#include <QShortcut>
 #include <QString>
 #include <QTextEdit>
 #include <QTimer>
@@ -21,7 +21,12 @@
 
 #include <algorithm>
 #include <csignal>
+#include <cstring>
+#include <functional>
 #include <iterator>
+#include <numeric>
+#include <queue>
+#include <tuple>
 #include <vector>
 
 #include "action.h"
@@ -31,8 +36,15 @@
 #include "filter.h"
 #include "hint.h"
 #include "logging.h"
+#include "macro.h"
+#include "marks.h"
+#include "objectpath.h"
 #include "overlay.h"
+#include "palette.h"
+#include "pixmapcache.h"
+#include "pointer.h"
 #include "probe.h"
+#include "usage.h"
 
 LOGGING_CATEGORY_COLOR("tetradactyl.controller", Qt::blue);
 
@@ -54,11 +66,25 @@ const std::map<HintMode, vector<const QMetaObject *>> hintableMetaObjects = {
 static ControllerSettings baseTestSettings() {
   return ControllerSettings{
       .hintChars = "ASDFJKL",
+      .filteredHintChars = "1234567890",
+      .hintCodeStyle = PrefixFreeCodes,
+      .hintOrdering = ReadingOrder,
+      .maxHintsPerPage = 300,
+      .usageWeightedHints = true,
+      .usageTableSize = 512,
+      .persistMarks = true,
       .autoAcceptUniqueHint = true,
       .highlightAcceptedHint = true,
       .highlightAcceptedHintMs = 400,
+      .fadeAcceptedHint = false,
       .passthroughKeyboardInput = true,
       .resetModeAfterFocusChange = true,
+      .hintPixmapCacheKb = 4096,
+      .nativeOverlaySurface = false,
+      .ignoreWindowClasses = {},
+      .keySequenceTimeoutMs = 1000,
+      .macroStepDelayMs = 0,
+      .macroWaitTimeoutMs = 2000,
       .keymap = {.activate = QKeySequence(Qt::Key_F),
                  .cancel = QKeySequence(Qt::Key_Escape),
                  .edit = QKeySequence(Qt::Key_G, Qt::Key_I),
@@ -68,7 +94,19 @@ static ControllerSettings baseTestSettings() {
                  .activateContext = QKeySequence(Qt::Key_C),
                  .upScroll = QKeySequence(Qt::Key_K),
                  .downScroll = QKeySequence(Qt::Key_J),
-                 .focusPrompt = QKeySequence(Qt::Key_Colon)},
+                 .focusPrompt = QKeySequence(Qt::Key_Colon),
+                 .activateFiltered = QKeySequence(Qt::Key_Slash),
+                 .toggleIgnore = QKeySequence(Qt::SHIFT | Qt::Key_Escape),
+                 .navigate = QKeySequence(Qt::Key_G, Qt::Key_N),
+                 .nextHintPage = QKeySequence(Qt::Key_Space),
+                 .activateRegion = QKeySequence(Qt::Key_G, Qt::Key_R),
+                 .pointer = QKeySequence(Qt::Key_G, Qt::Key_P),
+                 .repeat = QKeySequence(Qt::Key_Period),
+                 .setMark = QKeySequence(Qt::SHIFT | Qt::Key_M),
+                 .jumpToMark = QKeySequence(Qt::Key_Apostrophe),
+                 .recordMacro = QKeySequence(Qt::Key_Q),
+                 .replayMacro = QKeySequence(Qt::Key_At),
+                 .activateContinuous = QKeySequence(Qt::SHIFT | Qt::Key_F)},
   };
 }
 
@@ -94,8 +132,16 @@ Controller::Controller() : resetPending(false) {
 
   Controller::stylesheet = fetchStylesheet();
   qApp->setStyleSheet(Controller::stylesheet);
-  qApp->installEventFilter(new Tetradactyl::PrintFilter);
+  HintPixmapCache::instance()->warm(settings.hintChars);
+  if (settings.usageWeightedHints)
+    UsageTable::instance()->load();
+#if DEBUG
+  qApp->installEventFilter(new Tetradactyl::PrintFilter(this));
+#endif
+  // For ParentChange, the action events of the palette and the changes of
+  // what's hintable. Key presses are filtered by keyFilter.
   qApp->installEventFilter(this);
+  keyFilter = new KeyboardEventFilter(this);
 
   if (settings.resetModeAfterFocusChange) {
     connect(qApp, &QApplication::focusChanged, this,
@@ -143,6 +189,9 @@ void Controller::cleanupWindows() {
     delete winc;
     windowControllers.pop_back();
   }
+  windowLookup.clear();
+  updateApplicationFilter();
+  updateUiWatching();
 }
 
 void Controller::createController() {
@@ -158,10 +207,29 @@ void Controller::createController() {
   }
 }
 
+// bound on windowLookup, which keeps entries of dead windows until cleared
+static const int maxWindowLookupSize = 64;
+
+// Widgets of one window share the controller, so this is a hash lookup but
+// for the first widget of each window
 WindowController *Controller::findControllerForWidget(QWidget *widget) {
   if (widget == nullptr)
     return nullptr;
 
+  QWidget *window = widget->window();
+  auto search = windowLookup.constFind(window);
+  if (search != windowLookup.constEnd() && search->window == window)
+    return search->controller;
+
+  WindowController *found = searchControllerForWidget(window);
+  // entries of dead windows are dropped wholesale
+  if (windowLookup.size() > maxWindowLookupSize)
+    windowLookup.clear();
+  windowLookup.insert(window, WindowLookup{window, found});
+  return found;
+}
+
+WindowController *Controller::searchControllerForWidget(QWidget *widget) {
   for (auto winController : windowControllers) {
     // Two cases here: either the widget itself (potentially itself) has the
     // WindowController, or itself it's a popup of sorts (QMenu/QComboBox popup)
@@ -196,57 +264,94 @@ void Controller::attachControllerToWindow(QWidget *widget) {
   Q_ASSERT(isTetradactylWindow(widget));
   if (findControllerForWidget(widget) == nullptr) {
     logInfo << "Attaching Tetradactyl to" << widget;
-    self->windowControllers.append(new WindowController(widget, this));
-  }
-}
-
-bool Controller::eventFilter(QObject *receiver, QEvent *ev) {
-  QEvent::Type type = ev->type();
-  if (receiver->isWidgetType()) {
-    QWidget *widget = qobject_cast<QWidget *>(receiver);
-    if (type == QEvent::KeyPress) {
-      QKeyEvent *kev = static_cast<QKeyEvent *>(ev);
-      WindowController *windowController = findControllerForWidget(widget);
-      logInfo << "sending KeyPress event to" << windowController;
-      if (windowController) {
-        bool accepted = windowController->earlyKeyEventFilter(kev);
-        return accepted;
+    WindowController *windowController = new WindowController(widget, this);
+    self->windowControllers.append(windowController);
+    windowLookup.clear();
+    trackKeys(widget);
+    for (const QString &className : settings.ignoreWindowClasses) {
+      if (widget->inherits(className.toLatin1().constData())) {
+        windowController->setControllerMode(Ignore);
+        break;
       }
-    } else if (type == QEvent::ParentChange && !resetPending &&
-               objProbe->isClientWidget(widget)) {
-      // POLICY TEST: Reset windows on QWidget reparented
-      logInfo << "ParentChange" << type << "for" << receiver
-              << "Resetting Controller";
-      QTimer::singleShot(0, [] { tetradactyl->resetWindows(); });
     }
   }
-  return false;
 }
 
-void Controller::routeNewlyCreatedObject(QObject *obj) {
-  const QMetaObject *mo = obj->metaObject();
-  if (!mo->inherits(&QWidget::staticMetaObject)) {
+void Controller::trackKeys(QWidget *w) { keyFilter->track(w); }
+
+void Controller::setKeysIgnored(QWidget *window, bool ignored) {
+  keyFilter->setIgnored(window, ignored);
+  // reparenting went unnoticed meanwhile
+  if (!ignored)
+    windowLookup.clear();
+  updateApplicationFilter();
+}
+
+// The application-wide filter is dropped while every window is ignored. The
+// action events missed meanwhile are made up for by describing every action
+// again.
+void Controller::updateApplicationFilter() {
+  if (qApp == nullptr)
     return;
+  bool allIgnored = !windowControllers.isEmpty() &&
+                    std::all_of(windowControllers.begin(),
+                                windowControllers.end(), [](auto controller) {
+                                  return controller->controllerMode() == Ignore;
+                                });
+  if (allIgnored) {
+    qApp->removeEventFilter(this);
+  } else {
+    qApp->installEventFilter(this);
+    if (!applicationFiltered)
+      ActionIndex::invalidate();
   }
-  QWidget *widget = qobject_cast<QWidget *>(obj);
+  applicationFiltered = !allIgnored;
+}
 
-  // Create overlays for some types of QObject
-  if (mo->inherits(&QMenu::staticMetaObject)) {
+void Controller::updateUiWatching() {
+  watchingUi = std::any_of(
+      windowControllers.begin(), windowControllers.end(),
+      [](WindowController *controller) { return controller->isContinuous(); });
+}
 
-    // Object at this point may be a descendant of a window with a Tetradactyl
-    // controller, but it may not be.
-    QWidget *win = widget->window();
-    WindowController *winController = findControllerForWidget(win);
-    if (winController) {
-      winController->addOverlay(widget);
-    } else {
-      // TODO 11/09/20 psacawa: this is the case of a QMenu etc. added. We need
-      // to add the overlay if the controlling window is none, or set up a
-      // notification mechanism if it isn't.
-    }
+// Every event of the application passes here, so anything but ParentChange,
+// the action events feeding the palette and the events changing what's
+// hintable must bail out at once
+bool Controller::eventFilter(QObject *receiver, QEvent *ev) {
+  switch (ev->type()) {
+  case QEvent::ParentChange:
+    break;
+  case QEvent::Show:
+  case QEvent::Hide:
+  case QEvent::EnabledChange:
+    // hints and the chrome of overlays don't count
+    if (watchingUi && receiver->isWidgetType() &&
+        !isTetradactylObject(receiver) &&
+        (receiver->parent() == nullptr ||
+         !isTetradactylObject(receiver->parent())))
+      p_uiGeneration++;
+    return false;
+  case QEvent::ActionAdded:
+  case QEvent::ActionChanged:
+  case QEvent::ActionRemoved:
+    ActionIndex::instance()->actionEvent(static_cast<QActionEvent *>(ev));
+    return false;
+  default:
+    return false;
+  }
+  if (!receiver->isWidgetType())
+    return false;
+  // the widget may have moved to another window
+  windowLookup.clear();
+  if (!isTetradactylObject(receiver))
+    p_uiGeneration++;
+  QWidget *widget = static_cast<QWidget *>(receiver);
+  if (!resetPending && objProbe->isClientWidget(widget)) {
+    // POLICY TEST: Reset windows on QWidget reparented
+    logInfo << "ParentChange for" << receiver << "Resetting Controller";
+    QTimer::singleShot(0, [] { tetradactyl->resetWindows(); });
   }
-  // TODO 09/09/20 psacawa: add WindowController overlay or wait for show
-  // event as necessary
+  return false;
 }
 
 // Adjust controller states in response to QApplication::focusChanged. The
@@ -266,6 +371,11 @@ void Controller::resetModeAfterFocusChange(QWidget *old, QWidget *now) {
   logInfo << __FUNCTION__ << old << now;
   WindowController *oldWindowController = findControllerForWidget(old);
   WindowController *nowWindowController = findControllerForWidget(now);
+  // ignored windows keep their mode until it's toggled back
+  if (oldWindowController && oldWindowController->controllerMode() == Ignore)
+    oldWindowController = nullptr;
+  if (nowWindowController && nowWindowController->controllerMode() == Ignore)
+    return;
 
   // Case where old, now both have the same controller. This is the case in
   // multistep hinting
@@ -313,7 +423,7 @@ void Controller::resetModeAfterFocusWindowChanged(QWindow *focusWindow) {
 
   // handle Controller state changes for focusWidget
   WindowController *controller = findControllerForWidget(topLevelWidget);
-  if (controller == nullptr)
+  if (controller == nullptr || controller->controllerMode() == Ignore)
     return;
 
   BaseAction *action = controller->currentAction();
@@ -340,44 +450,84 @@ QDebug operator<<(QDebug debug, const Controller *controller) {
   return debug;
 }
 
-// while key handling in ControllerMode::Normal is being settlied, we use Qt
-// native shortcuts. This let's us use e.g. multi step key sequences, but it's
-// an issue and the clients own shortcuts, but it's a problem if there is an
-// shortcut collision.
-void WindowController::initializeShortcuts() {
-  ControllerKeymap &keymap = Controller::instance()->settings.keymap;
-  QShortcut *activateShortcut =
-      new QShortcut(keymap.activate, p_target, [this] { hint(); });
-  QShortcut *editShortcut = new QShortcut(keymap.edit, p_target,
-                                          [this] { hint(HintMode::Editable); });
-  QShortcut *yankShortcut = new QShortcut(keymap.yank, p_target,
-                                          [this] { hint(HintMode::Yankable); });
-  QShortcut *focusShortcut = new QShortcut(
-      keymap.focus, p_target, [this] { hint(HintMode::Focusable); });
-  QShortcut *contextMenuShortcut =
-      new QShortcut(keymap.activateContext, p_target,
-                    [this] { hint(HintMode::Contextable); });
-  QShortcut *menuShortcut = new QShortcut(keymap.activateMenu, p_target,
-                                          [this] { hint(HintMode::Menuable); });
-  QShortcut *cancelShortcut =
-      new QShortcut(keymap.cancel, p_target, [this] { cancel(); });
-  QShortcut *focusPromptShortcut = new QShortcut(
-      keymap.focusPrompt, p_target, [this] { this->focusPrompt(); });
-  shortcuts.append(activateShortcut);
-  shortcuts.append(editShortcut);
-  shortcuts.append(yankShortcut);
-  shortcuts.append(focusShortcut);
-  shortcuts.append(contextMenuShortcut);
-  shortcuts.append(menuShortcut);
-  shortcuts.append(cancelShortcut);
-  shortcuts.append(focusPromptShortcut);
+// Normal mode bindings are matched by a KeymapMachine in earlyKeyEventFilter
+// rather than QShortcuts, so that they needn't be toggled with the mode and
+// can take counts.
+void WindowController::initializeKeymap() {
+  keymap.compile(Controller::settings.keymap);
+  connect(&keymap, &KeymapMachine::triggered, this,
+          &WindowController::runKeymapAction);
+  connect(&keymap, &KeymapMachine::givenBack, this,
+          &WindowController::giveBackKeys);
+}
+
+void WindowController::runKeymapAction(KeymapAction action, int count) {
+  static const std::map<KeymapAction, HintMode> hintModes = {
+      {KeymapAction::Hint, Activatable},
+      {KeymapAction::HintEditable, Editable},
+      {KeymapAction::HintYankable, Yankable},
+      {KeymapAction::HintFocusable, Focusable},
+      {KeymapAction::HintContextable, Contextable},
+      {KeymapAction::HintMenuable, Menuable}};
+  auto search = hintModes.find(action);
+  if (search != hintModes.end()) {
+    // a count hints again after each accept
+    hintRepeats = count - 1;
+    hint(search->second);
+    return;
+  }
+  switch (action) {
+  case KeymapAction::HintFiltered:
+    hintFiltered();
+    break;
+  case KeymapAction::HintNavigated:
+    hintNavigated();
+    break;
+  case KeymapAction::HintRegions:
+    hintRegions();
+    break;
+  case KeymapAction::HintContinuous:
+    hintContinuous();
+    break;
+  case KeymapAction::Pointer:
+    pointer();
+    break;
+  case KeymapAction::Repeat:
+    for (int i = 0; i != count; ++i)
+      repeatLastAccept();
+    break;
+  case KeymapAction::SetMark:
+  case KeymapAction::JumpToMark:
+  case KeymapAction::ReplayMacro:
+    pendingRegister = action;
+    pendingCount = count;
+    break;
+  case KeymapAction::RecordMacro:
+    // q ends the recording by itself
+    if (isRecordingMacro())
+      toggleMacroRecording(recordingRegister);
+    else
+      pendingRegister = action;
+    break;
+  case KeymapAction::Cancel:
+    cancel();
+    break;
+  case KeymapAction::FocusPrompt:
+    focusPrompt();
+    break;
+  case KeymapAction::ToggleIgnore:
+    setControllerMode(Ignore);
+    break;
+  default:
+    break;
+  }
 }
 
 WindowController::WindowController(QWidget *_target, QObject *parent = nullptr)
     : QObject(parent), p_currentAction(nullptr), p_target(_target) {
 
   Q_ASSERT(parent);
-  initializeShortcuts();
+  initializeKeymap();
   initializeOverlays();
   Q_ASSERT(p_overlays.length() > 0);
   logInfo << "WindowController installs eventFilter on" << this;
@@ -385,14 +535,15 @@ WindowController::WindowController(QWidget *_target, QObject *parent = nullptr)
 }
 
 WindowController::~WindowController() {
-  for (auto &overlay : p_overlays) {
+  // deleting an overlay removes it from p_overlays
+  const QList<QPointer<Overlay>> overlays = p_overlays;
+  for (auto &overlay : overlays) {
     if (overlay)
       delete overlay;
   }
-  for (auto shortcut : shortcuts) {
-    if (shortcut)
-      delete shortcut;
-  }
+  while (!overlayPool.isEmpty())
+    delete overlayPool.takeLast();
+  delete ignoreShortcut;
 }
 
 // Find overlay which has the widget as *descendant*, not just as a child,
@@ -423,20 +574,22 @@ bool inputModeWhenWidgetFocussed(QWidget *w) {
 bool WindowController::earlyKeyEventFilter(QKeyEvent *kev) {
   logDebug << __FUNCTION__ << kev;
   auto type = kev->type();
+  if (holdingKeys) {
+    if (type == QEvent::KeyPress)
+      typeAhead.append({kev->key(), kev->modifiers(), kev->text()});
+    return true;
+  }
   if (type == QEvent::KeyPress) {
     switch (p_controllerMode) {
 
-    case ControllerMode::Normal: {
-      // Need to handle main shortcut logic here
-      switch (kev->key()) {
-      case Qt::Key_Tab:
-      case Qt::Key_Backtab:
-        // focus next/prev widget
-      default:
-        break;
-      }
-      break;
-    }
+    case ControllerMode::Normal:
+      if (pendingRegister != KeymapAction::None)
+        return registerKey(kev);
+      if (keymap.press(kev))
+        return true;
+      // The key ended a pending binding, e.g. "f" of "f" and "fy", which
+      // started hinting. It's then the first key of the code.
+      return p_controllerMode != Normal && earlyKeyEventFilter(kev);
 
     case ControllerMode::Hint: {
       switch (kev->key()) {
@@ -447,7 +600,10 @@ bool WindowController::earlyKeyEventFilter(QKeyEvent *kev) {
         acceptCurrent();
         return true;
       case Qt::Key_Backspace:
-        popKey();
+        if (p_filtering && hintBuffer.isEmpty())
+          popFilterKey();
+        else
+          popKey();
         return true;
       case Qt::Key_Tab:
       case Qt::Key_Backtab:
@@ -456,7 +612,32 @@ bool WindowController::earlyKeyEventFilter(QKeyEvent *kev) {
         // activeOverlay()->nextHint((true));
         return true;
       }
-      if ((kev->key() >= 'A') && (kev->key() <= 'Z')) {
+      if (KeymapMachine::matches(kev,
+                                 Controller::settings.keymap.nextHintPage)) {
+        nextHintPage();
+        return true;
+      }
+      if (p_navigating) {
+        static const std::map<int, Direction> directions = {
+            {Qt::Key_H, Direction::Left},
+            {Qt::Key_J, Direction::Down},
+            {Qt::Key_K, Direction::Up},
+            {Qt::Key_L, Direction::Right}};
+        auto search = directions.find(kev->key());
+        if (search != directions.end())
+          activeOverlay()->moveSelection(search->second);
+        // the hint codes are only for show
+        return search != directions.end() || !kev->text().isEmpty();
+      }
+      QChar ch = kev->text().isEmpty() ? QChar() : kev->text().at(0);
+      if (p_filtering && ch.isPrint() && !ch.isSpace()) {
+        if (ch.unicode() < 0x80 &&
+            strchr(Controller::settings.filteredHintChars, ch.toLatin1()))
+          pushKey(ch.toLatin1());
+        else
+          pushFilterKey(ch);
+        return true;
+      } else if ((kev->key() >= 'A') && (kev->key() <= 'Z')) {
         // std::isalpha doesn't work here
         logDebug << kev->key();
         pushKey(kev->key());
@@ -470,9 +651,16 @@ bool WindowController::earlyKeyEventFilter(QKeyEvent *kev) {
         escapeInput();
         return true;
       }
+      if (kev->key() == Qt::Key_Backspace)
+        recordStep({MacroStep::Text, None, QString(), QStringLiteral("\b")});
+      else if (!kev->text().isEmpty() && kev->text().at(0).isPrint())
+        recordStep({MacroStep::Text, None, QString(), kev->text()});
 
     case ControllerMode::Ignore:
       break;
+
+    case ControllerMode::Pointer:
+      return pointerKey(kev);
     }
   } else if (type == QEvent::KeyRelease) {
     // anything to do here?
@@ -480,6 +668,46 @@ bool WindowController::earlyKeyEventFilter(QKeyEvent *kev) {
   return false;
 }
 
+// Drop every filter of the window and leave one QShortcut to detect the toggle
+// key, so that the client runs as if Tetradactyl weren't injected at all
+void WindowController::suspend() {
+  logInfo << "Ignoring" << p_target;
+  p_target->removeEventFilter(this);
+  tetradactyl->setKeysIgnored(p_target, true);
+  ignoreShortcut =
+      new QShortcut(Controller::settings.keymap.toggleIgnore, p_target);
+  connect(ignoreShortcut, &QShortcut::activated, this,
+          [this] { setControllerMode(Normal); });
+}
+
+void WindowController::resume() {
+  logInfo << "No longer ignoring" << p_target;
+  // we may be in its activated() signal
+  if (ignoreShortcut)
+    ignoreShortcut->deleteLater();
+  p_target->installEventFilter(this);
+  tetradactyl->setKeysIgnored(p_target, false);
+  // resizes went unnoticed meanwhile
+  mainOverlay()->scheduleRelayout();
+}
+
+// Whether the key press is for Tetradactyl rather than for the shortcuts of
+// the client, which would otherwise get it first
+bool WindowController::claimsKey(QKeyEvent *kev) {
+  if (holdingKeys)
+    return true;
+  switch (p_controllerMode) {
+  case ControllerMode::Normal:
+    return pendingRegister != KeymapAction::None || keymap.wouldConsume(kev);
+  case ControllerMode::Hint:
+  case ControllerMode::Pointer:
+    return !(kev->modifiers() &
+             (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier));
+  default:
+    return false;
+  }
+}
+
 bool WindowController::eventFilter(QObject *obj, QEvent *ev) {
   auto type = ev->type();
   switch (type) {
@@ -487,7 +715,7 @@ bool WindowController::eventFilter(QObject *obj, QEvent *ev) {
     QWidget *widget = qobject_cast<QWidget *>(obj);
     Overlay *overlay = findOverlayForWidget(widget);
     if (overlay)
-      overlay->layout()->update();
+      overlay->scheduleRelayout();
     break;
   }
   default:
@@ -496,16 +724,9 @@ bool WindowController::eventFilter(QObject *obj, QEvent *ev) {
   return false;
 }
 
-// Current strategy: just search for the overlayable classes under the
-// target
-void WindowController::initializeOverlays() {
-  QList<QWidget *> widgets = p_target->findChildren<QWidget *>();
-  for (auto widget : qApp->topLevelWidgets()) {
-    if (isDescendantOf(widget, p_target)) {
-      tryAttachController(widget);
-    }
-  }
-}
+// Only the main overlay is made up front. Overlays of popups (QMenu etc.) are
+// made when a hint stage first targets them, see BaseAction::addNextStage.
+void WindowController::initializeOverlays() { addOverlay(p_target); }
 
 // The main overlay is considered to the be the one that has the others as
 // descendants.
@@ -523,13 +744,6 @@ Overlay *WindowController::mainOverlay() {
 
 // As with attachControllerToWindow, can be called to attach to existing
 // overlayable widget, or in response to one being created.
-void WindowController::tryAttachController(QWidget *target) {
-  // TODO 09/09/20 psacawa: add checks for both cases
-  if (target != nullptr) {
-    addOverlay(target);
-  }
-}
-
 Overlay *WindowController::activeOverlay() {
   QWidget *activeWidget = qApp->activePopupWidget();
   if (!activeWidget)
@@ -544,7 +758,19 @@ Overlay *WindowController::activeOverlay() {
 void WindowController::addOverlay(QWidget *target) {
   // exclude WindowType::Popup to get rid of QMenus
   bool isMainWindow = isTetradactylWindow(target);
-  Overlay *overlay = new Overlay(this, target, isMainWindow);
+  Overlay *overlay;
+  if (!isMainWindow && !overlayPool.isEmpty()) {
+    overlay = overlayPool.takeLast();
+    overlay->setHost(target);
+  } else {
+    overlay = new Overlay(this, target, isMainWindow);
+    // overlays die with their hosts
+    connect(overlay, &QObject::destroyed, this,
+            [this, overlay]() { removeOverlay(overlay, true); });
+  }
+  // popups get key presses without being focussed
+  if (!isMainWindow)
+    tetradactyl->trackKeys(target);
   p_overlays.append(overlay);
 }
 
@@ -553,26 +779,91 @@ void WindowController::removeOverlay(Overlay *overlay, bool fromSignal) {
     delete overlay;
     return;
   }
-  int idx = p_overlays.indexOf(overlay);
-  if (idx >= 0) {
-    p_overlays.removeAt(idx);
+  // by the time destroyed() is emitted, the QPointers to it are null
+  p_overlays.removeAll(QPointer<Overlay>());
+  overlayPool.removeAll(overlay);
+}
+
+// Detach the popup overlays of the finished hinting from their hosts. A few are
+// kept for the next popups, the rest deleted.
+void WindowController::releaseStageOverlays() {
+  for (int i = p_overlays.length() - 1; i >= 0; --i) {
+    Overlay *overlay = p_overlays.at(i);
+    if (overlay == nullptr || overlay->isMain())
+      continue;
+    p_overlays.removeAt(i);
+    if (overlayPool.length() < overlayPoolSize) {
+      overlay->setHost(nullptr);
+      overlayPool.append(overlay);
+    } else {
+      overlay->deleteLater();
+    }
   }
 }
 
+// Approximate memory held by overlays without hints, including pooled ones.
+size_t WindowController::idleOverlayBytes() {
+  size_t ret = 0;
+  for (auto overlay : p_overlays)
+    if (overlay && overlay->hints().isEmpty())
+      ret += overlay->approximateBytes();
+  for (auto overlay : overlayPool)
+    ret += overlay->approximateBytes();
+  return ret;
+}
+
 void WindowController::hint(HintMode hintMode) {
   if (!(controllerMode() == ControllerMode::Normal)) {
     logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
     return;
   }
   logInfo << "Hinting in " << hintMode << "at" << target();
+  startAction(BaseAction::createActionByHintMode(hintMode, this));
+}
+
+// Vimium's F: hinting stays on after each accept, until cancelled
+void WindowController::hintContinuous(HintMode hintMode) {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  setContinuous(true);
+  hintRepeats = 0;
+  hint(hintMode);
+}
+
+void WindowController::setContinuous(bool continuous) {
+  if (continuous == p_continuous)
+    return;
+  p_continuous = continuous;
+  Controller::instance()->updateUiWatching();
+}
+
+// Activation in two stages: first a region of the window, then a target in it
+void WindowController::hintRegions() {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  logInfo << "Hinting regions at" << target();
+  startAction(new RegionAction(this));
+}
+
+void WindowController::startAction(BaseAction *action) {
+  HintMode hintMode = action->mode;
   hintBuffer = "";
-  p_currentAction = BaseAction::createActionByHintMode(hintMode, this);
-  p_currentAction->act();
+  p_currentAction = action;
+  actHoldingKeys();
 
   // Action may terminate immediately if there are no hints made
   // TODO 22/09/20 psacawa: consolidate with the cleanupWindows code in accept()
   if (p_currentAction->isDone()) {
     cleanupAction();
+    p_filtering = false;
+    p_navigating = false;
+    setContinuous(false);
+    hintRepeats = 0;
+    replayTypeAhead();
     return;
   }
 
@@ -582,6 +873,145 @@ void WindowController::hint(HintMode hintMode) {
 
   setCurrentHintMode(hintMode);
   emit hinted(hintMode);
+  replayTypeAhead();
+}
+
+// Making hints may run a nested event loop in the client, e.g. to animate a
+// popup, and a fast typist's keys would then reach the client or get lost.
+// They are held back instead.
+void WindowController::actHoldingKeys() {
+  holdingKeys = true;
+  p_currentAction->act();
+  holdingKeys = false;
+}
+
+// Feed the held back keys in the order typed, as if they came now. Hint codes
+// resolve against the hints as data, without waiting for the labels to paint.
+// Keys neither Tetradactyl nor hinting take go on to the client.
+void WindowController::replayTypeAhead() {
+  // a replayed key may start hinting anew, which holds back more keys
+  if (replayingKeys)
+    return;
+  replayingKeys = true;
+  while (!typeAhead.isEmpty()) {
+    TypedKey typed = typeAhead.takeFirst();
+    QKeyEvent kev(QEvent::KeyPress, typed.key, typed.modifiers, typed.text);
+    if (earlyKeyEventFilter(&kev))
+      continue;
+    deliverKey(&kev);
+  }
+  replayingKeys = false;
+}
+
+// The digits of a count nothing was bound after, which the keymap gives back
+// to the client. As the key presses aren't spontaneous, Qt tries the shortcuts
+// of the client on them first.
+void WindowController::giveBackKeys(const QVector<TypedKey> &keys) {
+  for (const TypedKey &typed : keys) {
+    QKeyEvent kev(QEvent::KeyPress, typed.key, typed.modifiers, typed.text);
+    deliverKey(&kev);
+  }
+}
+
+// Key events go to the focus widget, else to the window
+void WindowController::deliverKey(QKeyEvent *kev) {
+  QWidget *focusWidget = qApp->focusWidget();
+  QCoreApplication::sendEvent(focusWidget ? focusWidget : p_target, kev);
+}
+
+// Vimium-style filtered hinting: letters narrow the hints down by their text and
+// the survivors get short codes over filteredHintChars.
+void WindowController::hintFiltered(HintMode hintMode) {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  p_filtering = true;
+  hint(hintMode);
+}
+
+// Hints are selected by moving from one to the nearest in a direction, and
+// accepted with <return>
+void WindowController::hintNavigated(HintMode hintMode) {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  p_navigating = true;
+  hint(hintMode);
+}
+
+// Drive a virtual mouse: each hint character narrows the cell to one of its
+// subcells, and the mouse events go to the center of the cell
+void WindowController::pointer() {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  // a grid of fewer cells than 2x2 doesn't narrow both ways
+  if (strlen(Controller::settings.hintChars) < 4) {
+    logWarning << "Pointer mode needs 4 hint characters at least";
+    return;
+  }
+  pointerOverlay = activeOverlay();
+  p_dragging = false;
+  pointerOverlay->showPointerGrid();
+  setControllerMode(Pointer);
+}
+
+// <enter> clicks, <s-enter> right-clicks, <up>/<down> scroll, and <space>
+// marks the start of a drag and then drops it
+bool WindowController::pointerKey(QKeyEvent *kev) {
+  if (!pointerOverlay) {
+    setControllerMode(Normal);
+    return false;
+  }
+  QWidget *host = pointerOverlay->host();
+  QPoint pos = pointerOverlay->pointerPosition();
+  switch (kev->key()) {
+  case Qt::Key_Escape:
+    setControllerMode(Normal);
+    return true;
+  case Qt::Key_Backspace:
+    pointerOverlay->widenPointerGrid();
+    return true;
+  case Qt::Key_Up:
+  case Qt::Key_Down:
+    sendScroll(host, pos, kev->key() == Qt::Key_Up ? 120 : -120);
+    return true;
+  case Qt::Key_Space:
+    if (!p_dragging) {
+      p_dragging = true;
+      dragStart = pos;
+      pointerOverlay->showPointerGrid();
+      return true;
+    }
+    setControllerMode(Normal);
+    sendDrag(host, dragStart, pos);
+    return true;
+  case Qt::Key_Return:
+  case Qt::Key_Enter:
+    // the click may open a popup, which takes the focus
+    setControllerMode(Normal);
+    sendClick(host, pos,
+              kev->modifiers() & Qt::ShiftModifier ? Qt::RightButton
+                                                   : Qt::LeftButton);
+    return true;
+  }
+  if (kev->text().isEmpty())
+    return false;
+  pointerOverlay->narrowPointerGrid(kev->text().at(0));
+  return true;
+}
+
+// Flip to the next page of candidates of the stage, without discovery
+void WindowController::nextHintPage() {
+  if (!(controllerMode() == ControllerMode::Hint)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  hintBuffer = "";
+  p_currentAction->nextPage();
 }
 
 void WindowController::acceptCurrent() {
@@ -603,30 +1033,251 @@ void WindowController::accept(QWidgetActionProxy *widgetProxy) {
   QWidget *w = widgetProxy->widget;
   logInfo << "Accepted " << w << "at" << widgetProxy->positionInWidget << "in"
           << p_currentHintMode;
+  if (Controller::settings.usageWeightedHints)
+    UsageTable::instance()->record(widgetProxy);
   if (Controller::settings.highlightAcceptedHint) {
-    QPointer<HintLabel> acceptedHint = activeOverlay()->selectedHint();
-    activeOverlay()->popHint(acceptedHint);
-    acceptedHint->setParent(activeOverlay()->parentWidget());
-    acceptedHint->show();
-    QTimer::singleShot(Controller::settings.highlightAcceptedHintMs,
-                       [acceptedHint]() {
-                         // make sure the hint still exist
-                         if (acceptedHint) {
-                           delete acceptedHint;
-                         }
-                       });
+    Overlay *overlay = activeOverlay();
+    if (overlay->selectedHint())
+      overlay->showTracer(overlay->selectedHint());
   }
   p_currentAction->accept(widgetProxy);
-  cleanupHints();
   if (p_currentAction->isDone()) {
+    HintMode mode = p_currentHintMode;
+    bool regions = qobject_cast<RegionAction *>(p_currentAction) != nullptr;
+    rememberAccept(widgetProxy, mode);
+    if (mode != Contextable && mode != Menuable && !regions)
+      recordStep({MacroStep::Accept, mode, widgetProxy->objectPath(), {}});
+    if (p_continuous && continueHinting(widgetProxy))
+      return;
+    cleanupHints();
     setControllerMode(p_currentAction->controllerModeAfterSuccess());
     cleanupAction();
     emit hintingFinished(true);
     // The controller mode is not reset here but rather in the Controller's
     // QApplication::focusChanged signal handler
+    if (hintRepeats > 0 && controllerMode() == Normal) {
+      hintRepeats--;
+      if (regions)
+        hintRegions();
+      else
+        hint(mode);
+    }
+  } else {
+    cleanupHints();
+    actHoldingKeys();
+    // A stage with nothing to hint, e.g. a region without targets, ends the
+    // action as a first stage would
+    if (p_currentAction->isDone()) {
+      cancel();
+      cleanupAction();
+    }
+    replayTypeAhead();
+  }
+}
+
+// Go on hinting after an accept of continuous hinting, unless the action
+// leaves Hint mode. The accepted hint is dropped and the rest stay under their
+// codes, without discovery, unless the UI changed meanwhile. Returns false
+// when there's nothing left to hint.
+bool WindowController::continueHinting(QWidgetActionProxy *accepted) {
+  if (controllerMode() != Hint ||
+      p_currentAction->controllerModeAfterSuccess() != Normal)
+    return false;
+  p_currentAction->setDone(false);
+  hintBuffer = "";
+  if (p_currentAction->isStale()) {
+    logInfo << "UI changed since discovery of" << p_currentAction;
+    cleanupHints();
+    actHoldingKeys();
+    if (p_currentAction->isDone())
+      return false;
   } else {
-    p_currentAction->act();
+    Overlay *overlay = activeOverlay();
+    for (HintLabel *hint : overlay->hints()) {
+      if (hint->proxy == accepted) {
+        overlay->removeHint(hint);
+        break;
+      }
+    }
+    if (overlay->hints().isEmpty()) {
+      if (!p_currentAction->hasCandidates()) {
+        p_currentAction->setDone(true);
+        return false;
+      }
+      p_currentAction->nextPage();
+    } else {
+      overlay->updateHints(hintBuffer);
+    }
+  }
+  replayTypeAhead();
+  return true;
+}
+
+// Menu items are only reached through their popups, so menu and context menu
+// actions aren't repeated.
+void WindowController::rememberAccept(QWidgetActionProxy *proxy,
+                                      HintMode mode) {
+  if (mode == Menuable || mode == Contextable)
+    return;
+  // the proxy is owned by lastAccepted from now on, not the action
+  p_currentAction->removeCandidate(proxy);
+  lastAccepted = {mode, QSharedPointer<QWidgetActionProxy>(proxy),
+                  proxy->widget, proxy->objectPath()};
+}
+
+// The proxy of the target, made anew from its object path if the widget is
+// gone. The path is looked for in the window of the controller first, and in
+// any other only if asked to.
+QWidgetActionProxy *WindowController::resolveTarget(AcceptTarget &target,
+                                                    bool anyWindow) {
+  if (target.proxy && target.widget)
+    return target.proxy.data();
+  ObjectPathCache *cache = ObjectPathCache::instance();
+  ObjectPathTarget resolved = cache->resolve(target.path, p_target);
+  if (resolved.widget == nullptr && anyWindow)
+    resolved = cache->resolve(target.path);
+  if (resolved.widget == nullptr)
+    return nullptr;
+  logInfo << "Resolved" << target.path << "to" << resolved.widget;
+  target.widget = resolved.widget;
+  target.proxy.reset(QWidgetActionProxy::createForObjectPath(resolved));
+  return target.proxy.data();
+}
+
+// Accept the target through a fresh action of its mode, without discovery or
+// hints
+bool WindowController::acceptAgain(AcceptTarget &target, bool anyWindow) {
+  QWidgetActionProxy *proxy = resolveTarget(target, anyWindow);
+  if (proxy == nullptr || !QWidgetActionProxy::visible(proxy->widget))
+    return false;
+  logInfo << "Accepting" << target.mode << "of" << proxy->widget << "again";
+  BaseAction *action = BaseAction::createActionByHintMode(target.mode, this);
+  setCurrentHintMode(target.mode);
+  action->accept(proxy);
+  ControllerMode mode = action->controllerModeAfterSuccess();
+  delete action;
+  recordStep({MacroStep::Accept, target.mode, target.path, {}});
+  setControllerMode(mode);
+  return true;
+}
+
+void WindowController::repeatLastAccept() {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  if (!acceptAgain(lastAccepted))
+    logWarning << "Nothing to repeat at" << lastAccepted.path;
+}
+
+// Save the target of the last accept under the letter, or else the focus
+// widget, to be focused again
+void WindowController::setMark(QChar letter) {
+  AcceptTarget target = lastAccepted;
+  if (!target.widget) {
+    QWidget *focus = qApp->focusWidget();
+    if (focus == nullptr || !p_target->isAncestorOf(focus)) {
+      logWarning << "Nothing to mark as" << letter;
+      return;
+    }
+    target = {Focusable, nullptr, focus, widgetPath(focus)};
   }
+  MarkTable::instance()->set(letter, target);
+}
+
+void WindowController::jumpToMark(QChar letter) {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  AcceptTarget *target = MarkTable::instance()->find(letter);
+  // persisted marks may have been set in another window
+  if (target == nullptr)
+    logWarning << "No mark" << letter;
+  else if (!acceptAgain(*target, true))
+    logWarning << "Mark" << letter << "not found at" << target->path;
+}
+
+// The key after a mark or macro binding names the register. Any other key
+// gives up, except that @@ replays the last register replayed.
+bool WindowController::registerKey(QKeyEvent *kev) {
+  if (kev->key() == Qt::Key_Shift)
+    return false;
+  KeymapAction action = pendingRegister;
+  pendingRegister = KeymapAction::None;
+  QChar letter = kev->text().isEmpty() ? QChar() : kev->text().at(0);
+  if (action == KeymapAction::ReplayMacro &&
+      KeymapMachine::matches(kev, Controller::settings.keymap.replayMacro))
+    letter = lastReplayedRegister;
+  if (!letter.isLetter())
+    return true;
+  switch (action) {
+  case KeymapAction::SetMark:
+    setMark(letter);
+    break;
+  case KeymapAction::JumpToMark:
+    jumpToMark(letter);
+    break;
+  case KeymapAction::RecordMacro:
+    toggleMacroRecording(letter);
+    break;
+  case KeymapAction::ReplayMacro:
+    replayMacro(letter, pendingCount);
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+// Start recording into the register, or store what was recorded. Only the
+// accepts of hints and what they lead to are recorded, not the keys.
+void WindowController::toggleMacroRecording(QChar reg) {
+  if (isRecordingMacro()) {
+    logInfo << "Recorded" << recordedMacro.size() << "steps into"
+            << recordingRegister;
+    macroRegisters().insert(recordingRegister, recordedMacro);
+    recordingRegister = QChar();
+    recordedMacro.clear();
+    return;
+  }
+  if (isReplayingMacro()) {
+    logWarning << "Can't record into" << reg << "while replaying";
+    return;
+  }
+  logInfo << "Recording into" << reg;
+  recordingRegister = reg;
+  recordedMacro.clear();
+}
+
+void WindowController::replayMacro(QChar reg, int count) {
+  if (!(controllerMode() == ControllerMode::Normal)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  auto search = macroRegisters().constFind(reg);
+  if (search == macroRegisters().constEnd()) {
+    logWarning << "No macro in" << reg;
+    return;
+  }
+  if (isReplayingMacro()) {
+    logWarning << "Already replaying a macro";
+    return;
+  }
+  lastReplayedRegister = reg;
+  macroPlayer = new MacroPlayer(this, search.value(), count);
+  macroPlayer->start();
+}
+
+// Consecutive typed text is one step
+void WindowController::recordStep(const MacroStep &step) {
+  if (!isRecordingMacro() || isReplayingMacro())
+    return;
+  if (step.kind == MacroStep::Text && !recordedMacro.isEmpty() &&
+      recordedMacro.last().kind == MacroStep::Text)
+    recordedMacro.last().text += step.text;
+  else
+    recordedMacro.append(step);
 }
 
 void WindowController::escapeInput() {
@@ -635,6 +1286,7 @@ void WindowController::escapeInput() {
   if (!focussedWidget)
     logWarning << "in" << ControllerMode::Input << "without a focussed widget";
   focussedWidget->clearFocus();
+  recordStep({MacroStep::EscapeInput, None, QString(), QString()});
   setControllerMode(Normal);
 }
 
@@ -653,6 +1305,31 @@ void WindowController::pushKey(char ch) {
   }
 }
 
+void WindowController::pushFilterKey(QChar ch) {
+  if (!(controllerMode() == ControllerMode::Hint)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  // codes are reassigned, so any partial code is void
+  hintBuffer = "";
+  filterHints(activeOverlay()->pushTextFilter(ch));
+}
+
+void WindowController::popFilterKey() {
+  if (!(controllerMode() == ControllerMode::Hint)) {
+    logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
+    return;
+  }
+  hintBuffer = "";
+  filterHints(activeOverlay()->popTextFilter());
+}
+
+// Unlike for codes, no match isn't a cancellation: the user may backspace.
+void WindowController::filterHints(int numVisibleHints) {
+  if (numVisibleHints == 1 && Controller::settings.autoAcceptUniqueHint)
+    acceptCurrent();
+}
+
 void WindowController::popKey() {
   if (!(controllerMode() == ControllerMode::Hint)) {
     logWarning << __PRETTY_FUNCTION__ << "from" << controllerMode();
@@ -687,6 +1364,7 @@ void WindowController::cancel() {
     return;
   }
   cleanupHints();
+  hintRepeats = 0;
   emit cancelled(p_currentHintMode);
   emit hintingFinished(false);
   setControllerMode(Normal);
@@ -725,15 +1403,29 @@ QList<QWidget *> WindowController::getHintables(HintMode hintMode) {
 void WindowController::setControllerMode(ControllerMode mode) {
   logInfo << __FUNCTION__ << "from" << p_controllerMode << "to" << mode;
   bool changed = mode != p_controllerMode;
+  ControllerMode oldMode = p_controllerMode;
   p_controllerMode = mode;
-  for (auto sc : shortcuts)
-    sc->setEnabled(mode == Normal);
 
   if (!changed)
     return;
 
+  keymap.reset();
+  keymap.setEnabled(mode == Normal);
+  pendingRegister = KeymapAction::None;
+  if (mode == Ignore)
+    suspend();
+  else if (oldMode == Ignore)
+    resume();
+
+  if (oldMode == Pointer && pointerOverlay)
+    pointerOverlay->hidePointerGrid();
+
   if (mode != Hint) {
     cleanupHints();
+    releaseStageOverlays();
+    p_filtering = false;
+    p_navigating = false;
+    setContinuous(false);
   }
 
   emit modeChanged(mode);
@@ -765,43 +1457,123 @@ QDebug operator<<(QDebug debug, const WindowController *controller) {
   return debug;
 }
 
-HintGenerator::HintGenerator(const char *_hintChars, size_t size)
-    : hintChars(_hintChars), pos(0) {
-  lengthOfHints = 0;
-  // find the minimum lengthOfHints to be able to generate enough hint
-  // strings
-  for (size_t numHintsGenerated = 1; numHintsGenerated < size;
-       numHintsGenerated *= hintChars.size()) {
-    lengthOfHints++;
-  }
-  // edge case
-  if (lengthOfHints == 0) {
-    lengthOfHints = 1;
-  }
+HintGenerator::HintGenerator() : hintChars(nullptr), numChars(0) {
+  offsets.append(0);
 }
 
 HintGenerator::~HintGenerator() {}
 
-string HintGenerator::operator*() { return generateHint(); }
+void HintGenerator::generate(const char *_hintChars, int n,
+                             HintCodeStyle style) {
+  hintChars = _hintChars;
+  numChars = strlen(hintChars);
+  Q_ASSERT(numChars >= 2);
+  buffer.resize(0);
+  offsets.resize(1);
+  if (n <= 0)
+    return;
 
-HintGenerator &HintGenerator::operator++() {
-  pos++;
-  return *this;
+  // find the minimum length of codes to be able to generate enough of them
+  int length = 1;
+  qint64 capacity = numChars;
+  for (; capacity < n; capacity *= numChars)
+    length++;
+  buffer.reserve(n * length);
+  offsets.reserve(n + 1);
+
+  if (style == FixedLengthCodes || length == 1) {
+    for (int i = 0; i != n; ++i)
+      appendCode(i, length);
+    return;
+  }
+
+  // Of the codes one shorter, keep the first ones and extend just enough of
+  // the last ones by every character. These are the least convenient
+  // characters, e.g. with 8 hints over "ASDFJKL": A S D F J K LA LS.
+  int shorter = capacity / numChars;
+  int extended = (n - shorter + numChars - 2) / (numChars - 1);
+  int kept = shorter - extended;
+  for (int i = 0; i != kept; ++i)
+    appendCode(i, length - 1);
+  for (int i = kept * numChars; size() < n; ++i)
+    appendCode(i, length);
 }
 
-HintGenerator &HintGenerator::operator++(int _) {
-  operator++();
-  return *this;
+// Codes longer than this aren't worth typing to save a key on frequent ones
+static const int maxWeightedCodeLength = 4;
+
+void HintGenerator::generate(const char *_hintChars,
+                             const QVector<double> &weights) {
+  int n = weights.length();
+  numChars = strlen(_hintChars);
+  if (n <= numChars) {
+    generate(_hintChars, n, PrefixFreeCodes);
+    return;
+  }
+
+  // Merge the numChars lightest nodes until one is left, padding with
+  // weightless leaves so that the last merge is full. Ties go to leaves, the
+  // later ones first, which keeps the tree shallow and the earlier targets
+  // on top. Parents are created after their children, so depths follow in
+  // one pass from the root down.
+  using Node = std::tuple<double, bool, int>; // weight, internal, -id
+  std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+  int numLeaves =
+      n + (numChars - 1 - (n - 1) % (numChars - 1)) % (numChars - 1);
+  std::vector<int> parent(numLeaves, -1);
+  for (int i = 0; i != numLeaves; ++i)
+    queue.push(Node(i < n ? weights.at(i) : 0.0, false, -i));
+  while (queue.size() > 1) {
+    double sum = 0;
+    int node = parent.size();
+    for (int j = 0; j != numChars; ++j) {
+      sum += std::get<0>(queue.top());
+      parent[-std::get<2>(queue.top())] = node;
+      queue.pop();
+    }
+    parent.push_back(-1);
+    queue.push(Node(sum, true, -node));
+  }
+  std::vector<int> depth(parent.size(), 0);
+  for (int node = parent.size() - 2; node >= 0; --node)
+    depth[node] = depth[parent[node]] + 1;
+  if (*std::max_element(depth.begin(), depth.begin() + n) >
+      maxWeightedCodeLength) {
+    generate(_hintChars, n, PrefixFreeCodes);
+    return;
+  }
+
+  // Canonical code: by increasing length, each code follows the previous one
+  // with zeros appended
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&depth](int a, int b) { return depth[a] < depth[b]; });
+  std::vector<qint64> values(n);
+  qint64 value = 0;
+  int length = depth[order.front()];
+  for (int i : order) {
+    for (; length < depth[i]; ++length)
+      value *= numChars;
+    values[i] = value++;
+  }
+
+  hintChars = _hintChars;
+  buffer.resize(0);
+  offsets.resize(1);
+  for (int i = 0; i != n; ++i)
+    appendCode(values[i], depth[i]);
 }
 
-string HintGenerator::generateHint() {
-  string ret(lengthOfHints, ' ');
-  size_t tmp = pos;
-  for (ssize_t idx = lengthOfHints - 1; idx >= 0; idx--) {
-    ret[idx] = hintChars[tmp % hintChars.length()];
-    tmp /= hintChars.length();
+// Write value in base numChars with length digits
+void HintGenerator::appendCode(qint64 value, int length) {
+  int start = buffer.length();
+  buffer.resize(start + length);
+  for (int idx = start + length - 1; idx >= start; idx--) {
+    buffer[idx] = hintChars[value % numChars];
+    value /= numChars;
   }
-  return ret;
+  offsets.append(buffer.length());
 }
 
 QString fetchStylesheet() {
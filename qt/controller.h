@@ -3,18 +3,26 @@
 
 #include <QAbstractButton>
 #include <QApplication>
+#include <QByteArray>
 #include <QDebug>
+#include <QHash>
 #include <QKeySequence>
+#include <QLatin1String>
 #include <QList>
 #include <QMap>
 #include <QPointer>
+#include <QSharedPointer>
 #include <QShortcut>
+#include <QStringList>
+#include <QVector>
 #include <QWidget>
 #include <QWindow>
 
 #include <map>
 #include <vector>
 
+#include "keymap.h"
+
 using std::size_t;
 using std::string;
 using std::vector;
@@ -24,6 +32,8 @@ namespace Tetradactyl {
 Q_NAMESPACE
 
 class HintLabel;
+class KeyboardEventFilter;
+class MacroPlayer;
 class Overlay;
 class BaseAction;
 class QWidgetActionProxy;
@@ -33,6 +43,18 @@ class WindowController;
 bool isTetradactylWindow(QWidget *w);
 bool isTetradactylOverlayable(QWidget *w);
 
+enum HintCodeStyle {
+  // minimal set of codes of two lengths, none a prefix of another
+  PrefixFreeCodes,
+  // all codes of the same length
+  FixedLengthCodes
+};
+Q_ENUM_NS(HintCodeStyle);
+
+// Which hints get the shortest codes
+enum HintOrdering { DiscoveryOrder, ReadingOrder, FocusProximityOrder };
+Q_ENUM_NS(HintOrdering);
+
 struct ControllerKeymap {
   QKeySequence activate;
   QKeySequence cancel;
@@ -44,16 +66,65 @@ struct ControllerKeymap {
   QKeySequence upScroll;
   QKeySequence downScroll;
   QKeySequence focusPrompt;
+  QKeySequence activateFiltered;
+  QKeySequence toggleIgnore;
+  QKeySequence navigate;
+  // in Hint mode, show the next page of hints
+  QKeySequence nextHintPage;
+  QKeySequence activateRegion;
+  // click, scroll or drag anywhere with a grid narrowed down key by key
+  QKeySequence pointer;
+  // accept the target of the last hinting again
+  QKeySequence repeat;
+  // followed by a letter, save the last accepted target or the focus widget as
+  // a mark, or accept the mark again
+  QKeySequence setMark;
+  QKeySequence jumpToMark;
+  // followed by a letter, record the accepts and typed text into the register
+  // until pressed again, or replay the register
+  QKeySequence recordMacro;
+  QKeySequence replayMacro;
+  // like activate, but hinting goes on after each accept until cancelled
+  QKeySequence activateContinuous;
 };
 
 struct ControllerSettings {
   const char *hintChars;
+  // codes of filtered hinting, where letters match the text of hints instead
+  const char *filteredHintChars;
+  HintCodeStyle hintCodeStyle;
+  HintOrdering hintOrdering;
+  // hints shown at once, 0 for no limit. Further candidates are put on pages
+  // going outwards from the focus
+  int maxHintsPerPage;
+  // give the most often accepted targets the shortest codes
+  bool usageWeightedHints;
+  // bound on the entries of the per-application usage table
+  int usageTableSize;
+  // keep marks per application between runs
+  bool persistMarks;
   bool autoAcceptUniqueHint;
   bool highlightAcceptedHint;
   int highlightAcceptedHintMs;
+  // fade the accepted hint out over highlightAcceptedHintMs
+  bool fadeAcceptedHint;
   bool passthroughKeyboardInput;
   // resetModeAfterFocusChange: broken by design?
   bool resetModeAfterFocusChange;
+  // memory cap of the rendered hint pixmaps shared by all overlays
+  int hintPixmapCacheKb;
+  // draw hints on a transparent top-level window above the host instead of
+  // a child widget, so hinting never repaints client widgets
+  bool nativeOverlaySurface;
+  // windows of these classes start in Ignore mode, e.g. games and canvases
+  QStringList ignoreWindowClasses;
+  // an incomplete multi-key binding is given up after this
+  int keySequenceTimeoutMs;
+  // pause between the steps of a replayed macro, 0 for as fast as the event
+  // loop goes
+  int macroStepDelayMs;
+  // how long a replayed step waits for its target to appear
+  int macroWaitTimeoutMs;
   ControllerKeymap keymap;
 };
 
@@ -70,9 +141,30 @@ enum HintMode {
 };
 Q_ENUM_NS(HintMode);
 
-enum ControllerMode { Normal, Hint, Input, Ignore };
+enum ControllerMode { Normal, Hint, Input, Ignore, Pointer };
 Q_ENUM_NS(ControllerMode);
 
+// A target to accept again without hinting. The proxy holds the tab or model
+// index of pseudo-widgets, and the path finds a widget made anew.
+struct AcceptTarget {
+  HintMode mode = None;
+  QSharedPointer<QWidgetActionProxy> proxy;
+  QPointer<QWidget> widget;
+  QString path;
+};
+
+// A step of a macro recorded with q<register>: the accept of the target at an
+// object path, text typed in Input mode, or leaving Input mode
+struct MacroStep {
+  enum Kind { Accept, Text, EscapeInput };
+  Kind kind;
+  HintMode mode = None;
+  QString path;
+  QString text;
+};
+
+using Macro = QVector<MacroStep>;
+
 QWidget *getToplevelWidgetForWindow(QWindow *win);
 
 #define tetradactyl Controller::instance()
@@ -104,6 +196,13 @@ public:
   static ControllerSettings settings;
   static QString stylesheet;
   WindowController *findControllerForWidget(QWidget *);
+  void trackKeys(QWidget *w);
+  void setKeysIgnored(QWidget *window, bool ignored);
+  // Bumped when client widgets are shown, hidden, enabled, disabled or
+  // reparented, so that a discovery can tell if it's out of date. Showing,
+  // hiding and enabling only count while some window hints continuously.
+  quint64 uiGeneration() const;
+  void updateUiWatching();
 
 signals:
   void started();
@@ -111,7 +210,6 @@ signals:
 
 public slots:
   static void createController();
-  void routeNewlyCreatedObject(QObject *obj);
   void resetModeAfterFocusChange(QWidget *old, QWidget *now);
   void resetModeAfterFocusWindowChanged(QWindow *focusWindow);
   void executeCommand(QString cmdline);
@@ -121,9 +219,24 @@ private:
   bool eventFilter(QObject *obj, QEvent *ev);
   void attachControllerToWindow(QWidget *widget);
   void initWindows();
+  WindowController *searchControllerForWidget(QWidget *);
+  void updateApplicationFilter();
   static const std::map<HintMode, vector<const QMetaObject *>>
       hintableMetaObjects;
   QList<WindowController *> windowControllers;
+  // findControllerForWidget() results by top-level window. The QPointer tells
+  // a live window from a new one allocated at the address of a dead one.
+  struct WindowLookup {
+    QPointer<QWidget> window;
+    WindowController *controller;
+  };
+  QHash<QWidget *, WindowLookup> windowLookup;
+  KeyboardEventFilter *keyFilter;
+  quint64 p_uiGeneration = 0;
+  // whether some window hints continuously
+  bool watchingUi = false;
+  // whether eventFilter() is installed on the application
+  bool applicationFiltered = true;
 
   bool resetPending;
 
@@ -137,6 +250,7 @@ inline Controller *Controller::instance() { return Controller::self; }
 inline const QList<WindowController *> &Controller::windows() const {
   return windowControllers;
 }
+inline quint64 Controller::uiGeneration() const { return p_uiGeneration; }
 
 // Manages Tetradactyl state for each toplevel "main" widgets. This means
 // Widgets that got shown, including diaglogs, but not WindowType::Popup
@@ -169,19 +283,40 @@ public:
 
   QWidget *target();
   bool earlyKeyEventFilter(QKeyEvent *ev);
+  bool claimsKey(QKeyEvent *ev);
   void addOverlay(QWidget *target);
   void removeOverlay(Overlay *overlay, bool fromSignal = false);
+  int pooledOverlays() const;
+  size_t idleOverlayBytes();
   bool isActing();
+  bool isFiltering();
+  bool isNavigating();
+  bool isContinuous();
   BaseAction *currentAction() { return p_currentAction; }
 
 public slots:
 
   void hint(HintMode mode = Activatable);
+  void hintFiltered(HintMode mode = Activatable);
+  void hintNavigated(HintMode mode = Activatable);
+  void hintRegions();
+  void hintContinuous(HintMode mode = Activatable);
+  void nextHintPage();
+  void pointer();
+  void repeatLastAccept();
+  void setMark(QChar letter);
+  void jumpToMark(QChar letter);
+  void toggleMacroRecording(QChar reg);
+  void replayMacro(QChar reg, int count = 1);
+  bool isRecordingMacro();
+  bool isReplayingMacro();
   void acceptCurrent();
   void cancel();
   void escapeInput();
   void pushKey(char ch);
   void popKey();
+  void pushFilterKey(QChar ch);
+  void popFilterKey();
   void focusPrompt();
 
 signals:
@@ -208,23 +343,73 @@ private:
   void cleanupAction();
   bool eventFilter(QObject *obj, QEvent *ev);
   void accept(QWidgetActionProxy *widgetProxy);
-  void filterHints();
-  void initializeShortcuts();
+  bool continueHinting(QWidgetActionProxy *accepted);
+  void filterHints(int numVisibleHints);
+  void runKeymapAction(KeymapAction action, int count);
+  void initializeKeymap();
+  void suspend();
+  void resume();
+  void startAction(BaseAction *action);
+  bool pointerKey(QKeyEvent *kev);
+  void rememberAccept(QWidgetActionProxy *proxy, HintMode mode);
+  QWidgetActionProxy *resolveTarget(AcceptTarget &target, bool anyWindow);
+  bool acceptAgain(AcceptTarget &target, bool anyWindow = false);
+  bool registerKey(QKeyEvent *kev);
+  void recordStep(const MacroStep &step);
+  void actHoldingKeys();
+  void replayTypeAhead();
+  void giveBackKeys(const QVector<TypedKey> &keys);
+  void deliverKey(QKeyEvent *kev);
   void initializeOverlays();
-  void tryAttachController(QWidget *widget);
+  void releaseStageOverlays();
+  void setContinuous(bool continuous);
 
   HintMode p_currentHintMode = HintMode::None;
   ControllerMode p_controllerMode = ControllerMode::Normal;
   BaseAction *p_currentAction;
   QWidget *p_target;
   QList<QPointer<Overlay>> p_overlays;
-  QList<QPointer<QShortcut>> shortcuts;
+  // hinting matches typed letters against the text of the hints
+  bool p_filtering = false;
+  // hinting moves the selection with h/j/k/l instead of taking codes
+  bool p_navigating = false;
+  // hinting stays on after an accept, with the hints left
+  bool p_continuous = false;
+  // detached popup overlays awaiting reuse
+  QList<Overlay *> overlayPool;
+  static const int overlayPoolSize = 4;
+  KeymapMachine keymap;
+  // accepts left to go of hinting started with a count
+  int hintRepeats = 0;
+  // the only thing listening for keys in Ignore mode
+  QPointer<QShortcut> ignoreShortcut;
+  // overlay showing the grid in Pointer mode, and the start of a drag there
+  QPointer<Overlay> pointerOverlay;
+  bool p_dragging = false;
+  QPoint dragStart;
+  // the target of the last accept that finished an action
+  AcceptTarget lastAccepted;
+  // a mark or macro binding waiting for the letter of its register, and the
+  // count it came with
+  KeymapAction pendingRegister = KeymapAction::None;
+  int pendingCount = 1;
+  // register being recorded into, if any, and the steps so far
+  QChar recordingRegister;
+  Macro recordedMacro;
+  QChar lastReplayedRegister;
+  QPointer<MacroPlayer> macroPlayer;
+  // Key presses which arrive while the hints of a stage are being made, to be
+  // replayed once they exist
+  QVector<TypedKey> typeAhead;
+  bool holdingKeys = false;
+  bool replayingKeys = false;
   // Currently "active" hint. <enter> will accept it. May be invalidated when
   // hintBuffer gets input
   // TODO 02/08/20 psacawa: custom iterator that only touches visible widgets
   QString hintBuffer;
 
   friend QDebug operator<<(QDebug debug, const WindowController *controller);
+  friend class MacroPlayer;
 };
 
 inline const QList<QPointer<Overlay>> WindowController::overlays() {
@@ -232,6 +417,18 @@ inline const QList<QPointer<Overlay>> WindowController::overlays() {
 }
 
 inline bool WindowController::isActing() { return p_currentAction != nullptr; }
+inline bool WindowController::isFiltering() { return p_filtering; }
+inline bool WindowController::isNavigating() { return p_navigating; }
+inline bool WindowController::isContinuous() { return p_continuous; }
+inline bool WindowController::isRecordingMacro() {
+  return !recordingRegister.isNull();
+}
+inline bool WindowController::isReplayingMacro() {
+  return !macroPlayer.isNull();
+}
+inline int WindowController::pooledOverlays() const {
+  return overlayPool.length();
+}
 
 inline HintMode WindowController::currentHintMode() {
   return p_currentHintMode;
@@ -247,24 +444,36 @@ inline ControllerMode WindowController::controllerMode() {
   return p_controllerMode;
 }
 
+// Generates hint codes over hintChars into buffers reused between calls.
+// Codes come shortest first, so the first hints are the quickest to type.
 class HintGenerator {
 
 public:
-  HintGenerator(const char *_hintChars, size_t size);
+  HintGenerator();
   virtual ~HintGenerator();
 
-  string operator*();
-  HintGenerator &operator++();
-  HintGenerator &operator++(int _);
+  void generate(const char *hintChars, int n, HintCodeStyle style);
+  // Huffman codes: the i-th code is shorter the heavier weights[i] is
+  void generate(const char *hintChars, const QVector<double> &weights);
+  int size() const;
+  QLatin1String operator[](int i) const;
 
 private:
-  string generateHint();
+  void appendCode(qint64 value, int length);
 
-  string hintChars;
-  size_t lengthOfHints;
-  size_t pos;
+  const char *hintChars;
+  int numChars;
+  QByteArray buffer;
+  // start of each code in buffer, followed by the end of the last
+  QVector<int> offsets;
 };
 
+inline int HintGenerator::size() const { return offsets.length() - 1; }
+inline QLatin1String HintGenerator::operator[](int i) const {
+  return QLatin1String(buffer.constData() + offsets.at(i),
+                       offsets.at(i + 1) - offsets.at(i));
+}
+
 QString fetchStylesheet();
 
 bool inputModeWhenWidgetFocussed(QWidget *w);
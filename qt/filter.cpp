@@ -22,56 +22,72 @@ LOGGING_CATEGORY_COLOR("tetradactyl.filter", Qt::green);
 
 namespace Tetradactyl {
 
-vector<const QMetaObject *> KeyboardEventFilter::inputMetaObjects = {
-    &QLineEdit::staticMetaObject, &QTextEdit::staticMetaObject};
-
-KeyboardEventFilter::KeyboardEventFilter(QObject *obj,
-                                         Tetradactyl::Controller *_controller)
-    : controller(_controller) {
-  if (obj) {
-    owner = obj;
-    obj->installEventFilter(this);
-  }
+KeyboardEventFilter::KeyboardEventFilter(Tetradactyl::Controller *_controller)
+    : QObject(_controller), controller(_controller) {
+  connect(qApp, &QApplication::focusChanged, this,
+          &KeyboardEventFilter::followFocus);
+  if (QWidget *focusWidget = qApp->focusWidget())
+    focusWidget->installEventFilter(this);
+}
+
+void KeyboardEventFilter::track(QWidget *w) {
+  if (isIgnored(w))
+    return;
+  logDebug << "Routing key presses of" << w;
+  w->installEventFilter(this);
 }
 
-bool KeyboardEventFilter::inputWidgetFocussed() {
+void KeyboardEventFilter::setIgnored(QWidget *window, bool ignored) {
   QWidget *focusWidget = qApp->focusWidget();
-  for (auto mo : inputMetaObjects) {
-    if (mo->cast(focusWidget) != nullptr) {
-      return true;
-    }
+  bool focusInWindow = focusWidget != nullptr &&
+                       controller->findControllerForWidget(focusWidget) ==
+                           controller->findControllerForWidget(window);
+  if (ignored) {
+    window->removeEventFilter(this);
+    if (focusInWindow)
+      focusWidget->removeEventFilter(this);
+  } else {
+    window->installEventFilter(this);
+    if (focusInWindow)
+      focusWidget->installEventFilter(this);
   }
-  return false;
 }
 
-bool KeyboardEventFilter::eventFilter(QObject *obj, QEvent *ev = nullptr) {
-  if (ev->type() == QEvent::KeyPress || ev->type() == QEvent::KeyRelease) {
-    if (ev->type() == QEvent::KeyPress) {
-
-      QKeyEvent __attribute__((unused)) *kev = static_cast<QKeyEvent *>(ev);
-      // Tetradactyl::ControllerKeymap &keymap = controller->settings.keymap;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-      QKeyCombination kc = QKeyCombination::fromCombined(kev->key());
-
-      // current technique to let input widgets get input is to avoid filtering
-      // the input if the current focussed widget is considered an input widget.
-      // Only  <esc> is captured to escape the focus
-
-      if (inputWidgetFocussed()) {
-        logInfo << "Input widget is focussed. Passing keypress" << kev;
-        if (kc == QKeyCombination(Qt::Key_Escape)) {
-          // is there a better default for focus to escape inputs?
-          // controller->target()->setFocus();
-          return true;
-        }
-        return false;
-      }
-#endif
-    }
+bool KeyboardEventFilter::isIgnored(QWidget *w) {
+  WindowController *windowController = controller->findControllerForWidget(w);
+  return windowController != nullptr &&
+         windowController->controllerMode() == Ignore;
+}
+
+// Key events go to the focus widget, else to the active window or popup
+void KeyboardEventFilter::followFocus(QWidget *old, QWidget *now) {
+  if (old != nullptr && !old->isWindow())
+    old->removeEventFilter(this);
+  if (now != nullptr && !isIgnored(now))
+    now->installEventFilter(this);
+}
+
+// Accepting ShortcutOverride makes Qt deliver the key press instead of
+// triggering a client shortcut bound to the same key
+bool KeyboardEventFilter::eventFilter(QObject *obj, QEvent *ev) {
+  QEvent::Type type = ev->type();
+  if (type != QEvent::KeyPress && type != QEvent::ShortcutOverride)
+    return false;
+  WindowController *windowController =
+      controller->findControllerForWidget(static_cast<QWidget *>(obj));
+  if (windowController == nullptr)
+    return false;
+  QKeyEvent *kev = static_cast<QKeyEvent *>(ev);
+  if (type == QEvent::ShortcutOverride) {
+    if (!windowController->claimsKey(kev))
+      return false;
+    ev->accept();
+    return true;
   }
-  return false;
+  return windowController->earlyKeyEventFilter(kev);
 }
 
+#if DEBUG
 // In the special case that  there are interested and disinterested items (a
 // user error), an interested match is enough to match
 bool PrintFilter::interestedInMetaObject(QObject *obj) {
@@ -119,10 +135,11 @@ bool PrintFilter::interestedInEventType(const QEvent &event) {
 }
 
 bool PrintFilter::eventFilter(QObject *obj, QEvent *ev) {
-  if (interestedInEventType(*ev) && interestedInMetaObject(obj)) {
+  if (on && interestedInEventType(*ev) && interestedInMetaObject(obj)) {
     logInfo << ev << obj;
   }
   return false;
 }
+#endif
 
 } // namespace Tetradactyl
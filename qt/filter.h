@@ -17,27 +17,34 @@ using std::vector;
 namespace Tetradactyl {
 class Controller;
 
+// Routes key presses to the WindowController of the receiver, ahead of the
+// shortcuts of the client. It's installed only on the tracked windows and
+// popups and on the focus widget, which receive the key events, so that the
+// other events of the application bypass Tetradactyl.
 class KeyboardEventFilter : public QObject {
   Q_OBJECT
 public:
-  KeyboardEventFilter(QObject *obj = nullptr,
-                      Tetradactyl::Controller *controller = nullptr);
+  KeyboardEventFilter(Tetradactyl::Controller *controller);
+
+  void track(QWidget *w);
+  // stop filtering the window and its focus widget altogether, or resume
+  void setIgnored(QWidget *window, bool ignored);
 
 protected:
   bool eventFilter(QObject *obj, QEvent *ev) override;
 
 private:
-  // vector <QKeySequence>
-  static vector<const QMetaObject *> inputMetaObjects;
-  bool inputWidgetFocussed();
-  QObject *owner = nullptr;
-  Tetradactyl::Controller *controller = nullptr;
+  void followFocus(QWidget *old, QWidget *now);
+  bool isIgnored(QWidget *w);
+
+  Tetradactyl::Controller *controller;
 };
 
+#if DEBUG
 class PrintFilter : public QObject {
   Q_OBJECT
 public:
-  PrintFilter() {}
+  PrintFilter(QObject *parent = nullptr) : QObject(parent) {}
   virtual ~PrintFilter() {}
 
 private:
@@ -63,5 +70,6 @@ private:
 
   bool eventFilter(QObject *obj, QEvent *ev);
 };
+#endif
 
 } // namespace Tetradactyl
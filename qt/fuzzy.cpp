@@ -0,0 +1,90 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QString>
+
+#include "fuzzy.h"
+
+namespace Tetradactyl {
+
+FuzzyIndex::FuzzyIndex() : levels(1) {}
+
+// Characters hashed onto 64 bits. Collisions only weaken the rejection.
+quint64 FuzzyIndex::charMask(QChar ch) {
+  return quint64(1) << (ch.unicode() % 64);
+}
+
+quint64 FuzzyIndex::textMask(const QString &text) {
+  quint64 mask = 0;
+  for (QChar ch : text)
+    mask |= charMask(ch);
+  return mask;
+}
+
+void FuzzyIndex::reset(const QStringList &_texts) {
+  texts.clear();
+  masks.clear();
+  texts.reserve(_texts.length());
+  masks.reserve(_texts.length());
+  Level all;
+  all.survivors.reserve(_texts.length());
+  all.positions.fill(0, _texts.length());
+  for (int i = 0; i != _texts.length(); ++i) {
+    QString text = _texts.at(i).toCaseFolded();
+    texts.append(text);
+    masks.append(textMask(text));
+    all.survivors.append(i);
+  }
+  levels.clear();
+  levels.append(all);
+  p_query.clear();
+}
+
+int FuzzyIndex::append(const QString &text) {
+  clearQuery();
+  texts.append(text.toCaseFolded());
+  masks.append(textMask(texts.last()));
+  levels[0].survivors.append(texts.length() - 1);
+  levels[0].positions.append(0);
+  return texts.length() - 1;
+}
+
+void FuzzyIndex::replace(int i, const QString &text) {
+  clearQuery();
+  texts[i] = text.toCaseFolded();
+  masks[i] = textMask(texts.at(i));
+}
+
+// Drop all but the level of the empty query, which holds every text
+void FuzzyIndex::clearQuery() {
+  levels.resize(1);
+  p_query.clear();
+}
+
+const QVector<int> &FuzzyIndex::push(QChar ch) {
+  ch = ch.toCaseFolded();
+  quint64 mask = charMask(ch);
+  const Level &last = levels.last();
+  Level next;
+  for (int j = 0; j != last.survivors.length(); ++j) {
+    int i = last.survivors.at(j);
+    if (!(masks.at(i) & mask))
+      continue;
+    int pos = texts.at(i).indexOf(ch, last.positions.at(j));
+    if (pos >= 0) {
+      next.survivors.append(i);
+      next.positions.append(pos + 1);
+    }
+  }
+  levels.append(next);
+  p_query.append(ch);
+  return levels.last().survivors;
+}
+
+const QVector<int> &FuzzyIndex::pop() {
+  if (levels.length() > 1) {
+    levels.removeLast();
+    p_query.chop(1);
+  }
+  return levels.last().survivors;
+}
+
+} // namespace Tetradactyl
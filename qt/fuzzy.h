@@ -0,0 +1,62 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+
+#include <QChar>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace Tetradactyl {
+
+// Incremental, case-insensitive subsequence matcher over a fixed set of texts.
+// Each candidate keeps the position in its text reached by the query so far,
+// so a keystroke only advances the survivors of the previous one, after a
+// cheap rejection by the set of characters in the text. Backspace pops back to
+// the previous survivors.
+class FuzzyIndex {
+public:
+  FuzzyIndex();
+
+  void reset(const QStringList &texts);
+  // Add a text, or replace the i-th, without case folding the rest again. The
+  // query starts over.
+  int append(const QString &text);
+  void replace(int i, const QString &text);
+  int length() const;
+  const QString &query() const;
+
+  // indices of the texts matching the query, in ascending order
+  const QVector<int> &survivors() const;
+  // position in its text after the match of the query, per survivor. Lower is
+  // an earlier and tighter match.
+  const QVector<int> &positions() const;
+  const QVector<int> &push(QChar ch);
+  const QVector<int> &pop();
+
+private:
+  static quint64 charMask(QChar ch);
+  static quint64 textMask(const QString &text);
+  void clearQuery();
+
+  QVector<QString> texts;
+  QVector<quint64> masks;
+
+  struct Level {
+    QVector<int> survivors;
+    // position after the last matched character, per survivor
+    QVector<int> positions;
+  };
+  QVector<Level> levels;
+  QString p_query;
+};
+
+inline int FuzzyIndex::length() const { return texts.length(); }
+inline const QString &FuzzyIndex::query() const { return p_query; }
+inline const QVector<int> &FuzzyIndex::survivors() const {
+  return levels.last().survivors;
+}
+inline const QVector<int> &FuzzyIndex::positions() const {
+  return levels.last().positions;
+}
+
+} // namespace Tetradactyl
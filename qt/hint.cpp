@@ -1,5 +1,6 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
 #include <QLabel>
+#include <QPainter>
 #include <QString>
 #include <qobject.h>
 
@@ -7,34 +8,58 @@
 #include "controller.h"
 #include "hint.h"
 #include "overlay.h"
+#include "pixmapcache.h"
 
 namespace Tetradactyl {
 
 HintLabel::HintLabel(QString text, QWidget *w, Overlay *overlay,
                      QWidgetActionProxy *_proxy)
-    : QLabel(text, overlay), proxy(_proxy), selected(false) {
+    : QLabel(text, overlay->hintParent()), proxy(_proxy), selected(false),
+      accepted(false) {
   p_positionInTarget = proxy->positionInWidget;
-  setStyleSheet(Tetradactyl::Controller::stylesheet);
   target = w;
-  p_positionInOverlay =
-      target->mapTo(overlay->parentWidget(), p_positionInTarget);
+  p_positionInOverlay = overlay->offsetOf(target) + p_positionInTarget;
 }
+
+HintLabel::HintLabel(HintState state)
+    : QLabel(), proxy(nullptr), target(nullptr),
+      selected(state == HintState::Selected),
+      accepted(state == HintState::Accepted) {
+  setAttribute(Qt::WA_DontShowOnScreen);
+  setStyleSheet(Controller::stylesheet);
+}
+
 HintLabel::~HintLabel() {}
 
-/*
- * QtWidgets' CSS implemenation is not dyamic like the browser layout engine is.
- * To get selector using a property to update, you have to reinstall the
- * stylesheet.
- */
+HintState HintLabel::state() {
+  if (accepted)
+    return HintState::Accepted;
+  return selected ? HintState::Selected : HintState::Normal;
+}
+
+// The stylesheet is only consulted when HintPixmapCache renders a string for
+// the first time, so changing the state is just a repaint.
 void HintLabel::setSelected(bool _selected) {
   if (selected != _selected) {
     selected = _selected;
-    setStyleSheet(Controller::stylesheet);
+    update();
   }
 }
 
-// May need to do something here to control how HintLabel is rendered when
-// QPaintEvent is sent to it directly (not via Overlay::paintEvent)
-void HintLabel::paintEvent(QPaintEvent *event) { QLabel::paintEvent(event); }
+QSize HintLabel::sizeHint() const {
+  return HintPixmapCache::instance()->size(text(), font());
+}
+
+void HintLabel::paintEvent(QPaintEvent *event) {
+  // templates paint themselves via the stylesheet
+  if (proxy == nullptr) {
+    QLabel::paintEvent(event);
+    return;
+  }
+  QPainter painter(this);
+  painter.drawPixmap(0, 0,
+                     HintPixmapCache::instance()->pixmap(
+                         text(), state(), font(), devicePixelRatioF()));
+}
 
 } // namespace Tetradactyl
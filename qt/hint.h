@@ -7,6 +7,8 @@
 namespace Tetradactyl {
 
 class Overlay;
+class HintPixmapCache;
+enum class HintState;
 
 class QWidgetActionProxy;
 
@@ -14,6 +16,7 @@ class HintLabel : public QLabel {
   Q_OBJECT
 public:
   Q_PROPERTY(bool selected READ isSelected WRITE setSelected);
+  Q_PROPERTY(bool accepted READ isAccepted);
   Q_PROPERTY(QPoint p_positionInTarget READ positionInTarget);
   Q_PROPERTY(QPoint p_positionInOverlay READ positionInOverlay);
 
@@ -22,10 +25,13 @@ public:
   virtual ~HintLabel();
 
   inline bool isSelected();
+  inline bool isAccepted();
   void setSelected(bool);
+  HintState state();
   QPoint positionInTarget();
   QPoint positionInOverlay();
 
+  QSize sizeHint() const override;
   void paintEvent(QPaintEvent *) override;
 
   QWidgetActionProxy *proxy;
@@ -33,11 +39,18 @@ public:
   QWidget *target;
 
 private:
+  // Offscreen template from which HintPixmapCache renders
+  explicit HintLabel(HintState state);
+
   bool selected;
+  bool accepted;
   QPoint p_positionInTarget;
+
+  friend class HintPixmapCache;
 };
 
 inline bool HintLabel::isSelected() { return selected; }
+inline bool HintLabel::isAccepted() { return accepted; }
 inline QPoint HintLabel::positionInTarget() { return p_positionInTarget; }
 inline QPoint HintLabel::positionInOverlay() { return p_positionInOverlay; }
 
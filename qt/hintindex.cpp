@@ -0,0 +1,218 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QPoint>
+#include <QString>
+
+#include <algorithm>
+
+#include "hint.h"
+#include "hintindex.h"
+
+namespace Tetradactyl {
+
+void HintIndex::setAlphabet(const QString &_alphabet) {
+  alphabet = _alphabet;
+  ordered = entries.isEmpty();
+  cursor = -1;
+  for (auto &entry : entries)
+    entry.key = keyOf(entry.hint->text());
+}
+
+// Characters are replaced by their rank in the alphabet, so that keys compare
+// in the order hints are generated in. Characters outside of it sort last.
+QString HintIndex::keyOf(const QString &text) const {
+  QString key(text.length(), Qt::Uninitialized);
+  for (int i = 0; i != text.length(); ++i) {
+    int rank = alphabet.indexOf(text.at(i));
+    if (rank < 0)
+      rank = alphabet.length() + text.at(i).unicode();
+    key[i] = QChar(static_cast<ushort>(qMin(rank + 1, 0xffff)));
+  }
+  return key;
+}
+
+// New hints are visible
+void HintIndex::add(HintLabel *hint) {
+  if (visibleCount() != entries.length()) {
+    // the range is only meaningful for the sorted entries
+    setVisible(0, visibleBegin, true);
+    setVisible(visibleEnd, entries.length(), true);
+  }
+  entries.append(Entry{keyOf(hint->text()), hint});
+  ordered = false;
+  cursor = -1;
+  visibleBegin = 0;
+  visibleEnd = entries.length();
+}
+
+void HintIndex::remove(HintLabel *hint) {
+  if (!ordered)
+    order();
+  int k = -1;
+  for (int i = 0; i != entries.length(); ++i) {
+    if (entries.at(i).hint == hint) {
+      k = i;
+      break;
+    }
+  }
+  if (k < 0)
+    return;
+  entries.removeAt(k);
+  // entries after k move down by one
+  auto shift = [k](std::vector<int> &indices) {
+    indices.erase(std::remove(indices.begin(), indices.end(), k),
+                  indices.end());
+    for (int &i : indices)
+      if (i > k)
+        i--;
+  };
+  shift(readingOrder);
+  shift(visibleOrder);
+  if (k < visibleBegin)
+    visibleBegin--;
+  if (k < visibleEnd)
+    visibleEnd--;
+  cursor = -1;
+}
+
+void HintIndex::clear() {
+  entries.clear();
+  readingOrder.clear();
+  visibleOrder.clear();
+  ordered = true;
+  cursor = -1;
+  visibleBegin = visibleEnd = 0;
+}
+
+void HintIndex::reset(const QVector<HintLabel *> &hints,
+                      std::vector<int> _readingOrder) {
+  entries.resize(hints.length());
+  for (int i = 0; i != hints.length(); ++i)
+    entries[i] = Entry{keyOf(hints.at(i)->text()), hints.at(i)};
+  readingOrder = std::move(_readingOrder);
+  visibleOrder = readingOrder;
+  ordered = true;
+  cursor = -1;
+  visibleBegin = 0;
+  visibleEnd = entries.length();
+}
+
+// Sort the entries by key, and rank them top to bottom and left to right
+void HintIndex::order() {
+  std::stable_sort(
+      entries.begin(), entries.end(),
+      [](const Entry &a, const Entry &b) { return a.key < b.key; });
+  readingOrder.resize(entries.length());
+  for (int i = 0; i != entries.length(); ++i)
+    readingOrder[i] = i;
+  std::stable_sort(readingOrder.begin(), readingOrder.end(),
+                   [this](int a, int b) {
+                     QPoint p = entries.at(a).hint->positionInOverlay();
+                     QPoint q = entries.at(b).hint->positionInOverlay();
+                     if (p.y() != q.y())
+                       return p.y() < q.y();
+                     return p.x() < q.x();
+                   });
+  // all capacity needed later is reserved here
+  visibleOrder.reserve(entries.length());
+  visibleOrder.clear();
+  for (int i : readingOrder)
+    if (i >= visibleBegin && i < visibleEnd)
+      visibleOrder.push_back(i);
+  ordered = true;
+}
+
+void HintIndex::setVisible(int begin, int end, bool visible) {
+  for (int i = begin; i < end; ++i)
+    entries.at(i).hint->setVisible(visible);
+}
+
+void HintIndex::filter(const QString &prefix) {
+  if (!ordered)
+    order();
+  QString key = keyOf(prefix);
+  auto begin = std::lower_bound(
+      entries.begin(), entries.end(), key,
+      [](const Entry &entry, const QString &key) { return entry.key < key; });
+  auto end = std::partition_point(begin, entries.end(), [&key](const Entry &e) {
+    return e.key.startsWith(key);
+  });
+  int newBegin = begin - entries.begin();
+  int newEnd = end - entries.begin();
+
+  // hide old \ new, then show new \ old
+  setVisible(visibleBegin, qMin(visibleEnd, newBegin), false);
+  setVisible(qMax(visibleBegin, newEnd), visibleEnd, false);
+  setVisible(newBegin, qMin(newEnd, visibleBegin), true);
+  setVisible(qMax(newBegin, visibleEnd), newEnd, true);
+  updateVisibleOrder(newBegin, newEnd);
+  visibleBegin = newBegin;
+  visibleEnd = newEnd;
+}
+
+// A narrower range, i.e. a key typed, drops entries from the visible order in
+// place. A wider one, after a backspace, takes them anew from the reading
+// order. The cursor follows the selected hint, if it stays visible.
+void HintIndex::updateVisibleOrder(int newBegin, int newEnd) {
+  int selected = cursor >= 0 ? visibleOrder[cursor] : -1;
+  cursor = -1;
+  auto keep = [=](int i) { return i >= newBegin && i < newEnd; };
+  if (newBegin >= visibleBegin && newEnd <= visibleEnd) {
+    size_t kept = 0;
+    for (size_t j = 0; j != visibleOrder.size(); ++j) {
+      int i = visibleOrder[j];
+      if (!keep(i))
+        continue;
+      if (i == selected)
+        cursor = kept;
+      visibleOrder[kept++] = i;
+    }
+    visibleOrder.resize(kept);
+  } else {
+    visibleOrder.clear();
+    for (int i : readingOrder) {
+      if (!keep(i))
+        continue;
+      if (i == selected)
+        cursor = visibleOrder.size();
+      visibleOrder.push_back(i);
+    }
+  }
+}
+
+HintLabel *HintIndex::visibleAt(int i) {
+  if (!ordered)
+    order();
+  return entries.at(visibleOrder[i]).hint;
+}
+
+HintLabel *HintIndex::firstVisible() {
+  return visibleCount() > 0 ? visibleAt(0) : nullptr;
+}
+
+// Only done when the selection is reset, so the linear search is fine
+void HintIndex::select(HintLabel *hint) {
+  if (!ordered)
+    order();
+  cursor = -1;
+  for (size_t j = 0; j != visibleOrder.size(); ++j) {
+    if (entries.at(visibleOrder[j]).hint == hint) {
+      cursor = j;
+      return;
+    }
+  }
+}
+
+HintLabel *HintIndex::step(bool forward) {
+  if (!ordered)
+    order();
+  int n = visibleOrder.size();
+  if (n == 0)
+    return nullptr;
+  if (cursor < 0)
+    cursor = forward ? 0 : n - 1;
+  else
+    cursor = (cursor + (forward ? 1 : n - 1)) % n;
+  return entries.at(visibleOrder[cursor]).hint;
+}
+
+} // namespace Tetradactyl
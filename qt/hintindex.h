@@ -0,0 +1,69 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include <vector>
+
+namespace Tetradactyl {
+
+class HintLabel;
+
+// Hints of an overlay sorted by their text in the order of the hint alphabet,
+// so that the hints starting with a typed prefix form a contiguous range, which
+// is found by binary search. Filtering shows/hides only the hints entering or
+// leaving that range.
+//
+// The visible hints are also kept in reading order, along with a cursor for
+// the selected hint, so that Tab and Backtab step through them in O(1).
+class HintIndex {
+public:
+  void setAlphabet(const QString &alphabet);
+  void add(HintLabel *hint);
+  // Drop the hint, leaving the others in order under their codes
+  void remove(HintLabel *hint);
+  void clear();
+  // Replace the hints with ones already in the order of their codes, given
+  // their reading order, without sorting
+  void reset(const QVector<HintLabel *> &hints, std::vector<int> readingOrder);
+  bool isEmpty() const;
+
+  void filter(const QString &prefix);
+  int visibleCount() const;
+  // visible hints in reading order
+  HintLabel *visibleAt(int i);
+  HintLabel *firstVisible();
+  // Move the cursor onto the hint, or off all hints if it isn't visible
+  void select(HintLabel *hint);
+  // Move the cursor to the next or previous visible hint, wrapping around
+  HintLabel *step(bool forward);
+
+private:
+  struct Entry {
+    QString key;
+    HintLabel *hint;
+  };
+
+  QString keyOf(const QString &text) const;
+  void order();
+  void setVisible(int begin, int end, bool visible);
+  void updateVisibleOrder(int newBegin, int newEnd);
+
+  QString alphabet;
+  QVector<Entry> entries;
+  bool ordered = true;
+  // range of entries currently visible
+  int visibleBegin = 0;
+  int visibleEnd = 0;
+  // indices of entries in reading order, all and the visible range only
+  std::vector<int> readingOrder;
+  std::vector<int> visibleOrder;
+  // position of the selected hint in visibleOrder, or -1
+  int cursor = -1;
+};
+
+inline bool HintIndex::isEmpty() const { return entries.isEmpty(); }
+inline int HintIndex::visibleCount() const { return visibleEnd - visibleBegin; }
+
+} // namespace Tetradactyl
@@ -0,0 +1,206 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QKeyEvent>
+#include <QKeySequence>
+#include <QLoggingCategory>
+
+#include "controller.h"
+#include "keymap.h"
+#include "logging.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.keymap", Qt::magenta);
+
+namespace Tetradactyl {
+
+// counts beyond this are surely typos
+static const int maxCount = 9999;
+
+static int combinedKey(const QKeySequence &sequence, int i) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  return sequence[i].toCombined();
+#else
+  return sequence[i];
+#endif
+}
+
+static bool isModifierKey(int key) {
+  return key == Qt::Key_Shift || key == Qt::Key_Control ||
+         key == Qt::Key_Alt || key == Qt::Key_Meta || key == Qt::Key_AltGr;
+}
+
+KeymapMachine::KeymapMachine(QObject *parent) : QObject(parent), nodes(1) {
+  timeout.setSingleShot(true);
+  connect(&timeout, &QTimer::timeout, this, &KeymapMachine::expire);
+}
+
+void KeymapMachine::compile(const ControllerKeymap &keymap) {
+  nodes.assign(1, Node());
+  reset();
+  timeout.setInterval(Controller::settings.keySequenceTimeoutMs);
+  bind(keymap.activate, KeymapAction::Hint);
+  bind(keymap.edit, KeymapAction::HintEditable);
+  bind(keymap.yank, KeymapAction::HintYankable);
+  bind(keymap.focus, KeymapAction::HintFocusable);
+  bind(keymap.activateContext, KeymapAction::HintContextable);
+  bind(keymap.activateMenu, KeymapAction::HintMenuable);
+  bind(keymap.activateFiltered, KeymapAction::HintFiltered);
+  bind(keymap.navigate, KeymapAction::HintNavigated);
+  bind(keymap.activateRegion, KeymapAction::HintRegions);
+  bind(keymap.pointer, KeymapAction::Pointer);
+  bind(keymap.repeat, KeymapAction::Repeat);
+  bind(keymap.setMark, KeymapAction::SetMark);
+  bind(keymap.jumpToMark, KeymapAction::JumpToMark);
+  bind(keymap.recordMacro, KeymapAction::RecordMacro);
+  bind(keymap.replayMacro, KeymapAction::ReplayMacro);
+  bind(keymap.activateContinuous, KeymapAction::HintContinuous);
+  bind(keymap.cancel, KeymapAction::Cancel);
+  bind(keymap.focusPrompt, KeymapAction::FocusPrompt);
+  bind(keymap.toggleIgnore, KeymapAction::ToggleIgnore);
+}
+
+void KeymapMachine::bind(const QKeySequence &sequence, KeymapAction action) {
+  if (sequence.isEmpty())
+    return;
+  int node = 0;
+  for (int i = 0; i != sequence.count(); ++i) {
+    int code = combinedKey(sequence, i);
+    auto search = nodes[node].children.constFind(code);
+    if (search != nodes[node].children.constEnd()) {
+      node = search.value();
+    } else {
+      int child = nodes.size();
+      nodes.push_back(Node());
+      nodes[node].children.insert(code, child);
+      node = child;
+    }
+  }
+  if (nodes[node].action != KeymapAction::None)
+    logWarning << "Rebinding" << sequence;
+  nodes[node].action = action;
+}
+
+// The key with modifiers, as found in a QKeySequence. Shifted symbols like ':'
+// are bound without Shift, unlike capital letters.
+int KeymapMachine::keyCode(QKeyEvent *kev) {
+  int key = kev->key();
+  Qt::KeyboardModifiers modifiers =
+      kev->modifiers() & (Qt::ShiftModifier | Qt::ControlModifier |
+                          Qt::AltModifier | Qt::MetaModifier);
+  bool letter = key >= Qt::Key_A && key <= Qt::Key_Z;
+  if (!letter && !kev->text().isEmpty() && kev->text().at(0).isPrint())
+    modifiers &= ~Qt::ShiftModifier;
+  return key | static_cast<int>(modifiers);
+}
+
+bool KeymapMachine::matches(QKeyEvent *kev, const QKeySequence &sequence) {
+  return sequence.count() == 1 && combinedKey(sequence, 0) == keyCode(kev);
+}
+
+// A digit starts or continues a count only outside of a sequence, and 0 only
+// continues one, unless the digit is itself bound.
+bool KeymapMachine::isCountDigit(int code) const {
+  if (state != 0 || nodes[0].children.contains(code))
+    return false;
+  return (code >= Qt::Key_1 && code <= Qt::Key_9) ||
+         (code == Qt::Key_0 && count != 0);
+}
+
+bool KeymapMachine::press(QKeyEvent *kev) {
+  if (!enabled || givingBack || isModifierKey(kev->key()))
+    return false;
+  int code = keyCode(kev);
+  if (isCountDigit(code)) {
+    count = qMin(count * 10 + (code - Qt::Key_0), maxCount);
+    countKeys.append({kev->key(), kev->modifiers(), kev->text()});
+    timeout.start();
+    return true;
+  }
+
+  auto search = nodes[state].children.constFind(code);
+  if (search == nodes[state].children.constEnd()) {
+    // An incomplete sequence is fired if it's bound itself, and else given up,
+    // and the key tried again from the root
+    bool inSequence = state != 0;
+    if (inSequence && nodes[state].action != KeymapAction::None) {
+      fire(nodes[state].action);
+      return press(kev);
+    }
+    bool counted = count != 0;
+    giveUp();
+    if (inSequence && press(kev))
+      return true;
+    // the key which ended a count follows it, rather than overtaking it
+    if (counted)
+      giveBack({TypedKey{kev->key(), kev->modifiers(), kev->text()}});
+    return counted;
+  }
+
+  state = search.value();
+  const Node &node = nodes[state];
+  if (node.children.isEmpty())
+    fire(node.action);
+  else
+    timeout.start();
+  return true;
+}
+
+bool KeymapMachine::wouldConsume(QKeyEvent *kev) const {
+  if (!enabled || givingBack || isModifierKey(kev->key()))
+    return false;
+  int code = keyCode(kev);
+  if (isCountDigit(code) || nodes[state].children.contains(code))
+    return true;
+  // Otherwise the key fires a pending binding and goes on to the mode that it
+  // enters, starts over from the root, or is given back after a count
+  return count != 0 ||
+         (state != 0 && (nodes[state].action != KeymapAction::None ||
+                         nodes[0].children.contains(code)));
+}
+
+void KeymapMachine::reset() {
+  timeout.stop();
+  state = 0;
+  count = 0;
+  countKeys.clear();
+}
+
+void KeymapMachine::setEnabled(bool _enabled) {
+  enabled = _enabled;
+  if (!enabled)
+    reset();
+}
+
+void KeymapMachine::fire(KeymapAction action) {
+  int repeat = qMax(1, count);
+  reset();
+  logDebug << "Firing keymap action" << static_cast<int>(action) << "x"
+           << repeat;
+  emit triggered(action, repeat);
+}
+
+// The pending sequence is fired if it's a binding, and else given up
+void KeymapMachine::expire() {
+  KeymapAction action = nodes[state].action;
+  if (action != KeymapAction::None)
+    fire(action);
+  else
+    giveUp();
+}
+
+// Forget the pending input, and give the digits of its count back
+void KeymapMachine::giveUp() {
+  QVector<TypedKey> keys;
+  keys.swap(countKeys);
+  reset();
+  giveBack(keys);
+}
+
+void KeymapMachine::giveBack(const QVector<TypedKey> &keys) {
+  if (keys.isEmpty())
+    return;
+  logDebug << "Giving back" << keys.size() << "keys";
+  givingBack = true;
+  emit givenBack(keys);
+  givingBack = false;
+}
+
+} // namespace Tetradactyl
@@ -0,0 +1,105 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QHash>
+#include <QKeyEvent>
+#include <QKeySequence>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include <vector>
+
+namespace Tetradactyl {
+
+struct ControllerKeymap;
+
+// A key press kept to be delivered later
+struct TypedKey {
+  int key;
+  Qt::KeyboardModifiers modifiers;
+  QString text;
+};
+
+enum class KeymapAction {
+  None,
+  Hint,
+  HintEditable,
+  HintYankable,
+  HintFocusable,
+  HintContextable,
+  HintMenuable,
+  HintFiltered,
+  HintNavigated,
+  HintRegions,
+  Pointer,
+  Repeat,
+  SetMark,
+  JumpToMark,
+  RecordMacro,
+  ReplayMacro,
+  HintContinuous,
+  Cancel,
+  FocusPrompt,
+  ToggleIgnore
+};
+
+// ControllerKeymap compiled into a trie over key combinations, fed one key
+// press at a time from WindowController::earlyKeyEventFilter. A binding fires
+// once its sequence is complete. A sequence which is also the prefix of a
+// longer binding fires when no further key comes within the timeout. Digits
+// typed before a binding are its count. The digits of a count which ends in no
+// binding, by an unbound key or the timeout, are given back to the client in
+// the order typed, followed by the key which ended it. The keys of an
+// unfinished sequence, and a count cut short by a change of mode, are dropped.
+class KeymapMachine : public QObject {
+  Q_OBJECT
+public:
+  KeymapMachine(QObject *parent = nullptr);
+
+  void compile(const ControllerKeymap &keymap);
+  void bind(const QKeySequence &sequence, KeymapAction action);
+  // Returns whether the key belongs to a binding or count and was consumed
+  bool press(QKeyEvent *kev);
+  // whether press() would consume the key, without side effects
+  bool wouldConsume(QKeyEvent *kev) const;
+  bool isPending() const;
+  void reset();
+  // a disabled machine consumes no keys, e.g. outside of Normal mode
+  void setEnabled(bool enabled);
+
+  static int keyCode(QKeyEvent *kev);
+  // whether the key press is the single key sequence
+  static bool matches(QKeyEvent *kev, const QKeySequence &sequence);
+
+signals:
+  void triggered(KeymapAction action, int count);
+  // The machine consumes no keys while the slots run, so they can deliver the
+  // keys straight away
+  void givenBack(const QVector<TypedKey> &keys);
+
+private:
+  struct Node {
+    QHash<int, int> children;
+    KeymapAction action = KeymapAction::None;
+  };
+
+  bool isCountDigit(int code) const;
+  void fire(KeymapAction action);
+  void expire();
+  void giveUp();
+  void giveBack(const QVector<TypedKey> &keys);
+
+  std::vector<Node> nodes;
+  int state = 0;
+  int count = 0;
+  // the key presses of count
+  QVector<TypedKey> countKeys;
+  bool enabled = true;
+  bool givingBack = false;
+  QTimer timeout;
+};
+
+inline bool KeymapMachine::isPending() const { return state != 0 || count != 0; }
+
+} // namespace Tetradactyl
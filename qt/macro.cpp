@@ -0,0 +1,111 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QApplication>
+#include <QKeyEvent>
+#include <QLoggingCategory>
+#include <QWidget>
+
+#include "logging.h"
+#include "macro.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.macro", Qt::yellow);
+
+namespace Tetradactyl {
+
+// steps waiting for their target are retried this often
+static const int waitIntervalMs = 10;
+
+QHash<QChar, Macro> &macroRegisters() {
+  static QHash<QChar, Macro> registers;
+  return registers;
+}
+
+MacroPlayer::MacroPlayer(WindowController *controller, const Macro &_macro,
+                         int _count)
+    : QObject(controller), windowController(controller), macro(_macro),
+      targets(_macro.size()), count(_count), stepNs(_macro.size(), 0) {
+  for (int i = 0; i != macro.size(); ++i)
+    targets[i] = {macro.at(i).mode, nullptr, nullptr, macro.at(i).path};
+  next.setSingleShot(true);
+  connect(&next, &QTimer::timeout, this, &MacroPlayer::runNextStep);
+}
+
+void MacroPlayer::start() {
+  logInfo << "Replaying" << macro.size() << "steps" << count << "times";
+  elapsed.start();
+  next.start(0);
+}
+
+void MacroPlayer::runNextStep() {
+  if (repetition == count || macro.isEmpty()) {
+    finish(true);
+    return;
+  }
+  QElapsedTimer stepTimer;
+  stepTimer.start();
+  bool ok = runStep(step);
+  stepNs[step] += stepTimer.nsecsElapsed();
+  if (!ok) {
+    if (!waiting.isValid())
+      waiting.start();
+    if (waiting.elapsed() < Controller::settings.macroWaitTimeoutMs) {
+      next.start(waitIntervalMs);
+      return;
+    }
+    logWarning << "Step" << step << "found no" << macro.at(step).path;
+    finish(false);
+    return;
+  }
+  waiting.invalidate();
+  if (++step == macro.size()) {
+    step = 0;
+    repetition++;
+  }
+  next.start(Controller::settings.macroStepDelayMs);
+}
+
+// Typed text goes to the focus widget a key at a time, as the user typed it
+bool MacroPlayer::runStep(int i) {
+  const MacroStep &macroStep = macro.at(i);
+  switch (macroStep.kind) {
+  case MacroStep::Accept:
+    if (windowController->controllerMode() != Normal)
+      return false;
+    return windowController->acceptAgain(targets[i]);
+  case MacroStep::Text: {
+    QWidget *focusWidget = qApp->focusWidget();
+    if (focusWidget == nullptr)
+      return false;
+    for (QChar ch : macroStep.text) {
+      // Qt key codes of Latin-1 characters are their upper case
+      int key = ch == QLatin1Char('\b') ? Qt::Key_Backspace
+                                        : ch.toUpper().unicode();
+      QString text = ch == QLatin1Char('\b') ? QString() : QString(ch);
+      QKeyEvent press(QEvent::KeyPress, key, Qt::NoModifier, text);
+      QApplication::sendEvent(focusWidget, &press);
+      QKeyEvent release(QEvent::KeyRelease, key, Qt::NoModifier, text);
+      QApplication::sendEvent(focusWidget, &release);
+    }
+    return true;
+  }
+  case MacroStep::EscapeInput:
+    if (windowController->controllerMode() == Input)
+      windowController->escapeInput();
+    return true;
+  }
+  return false;
+}
+
+void MacroPlayer::finish(bool ok) {
+  next.stop();
+  qint64 totalNs = elapsed.nsecsElapsed();
+  int runs = qMax(1, repetition);
+  for (int i = 0; i != macro.size(); ++i)
+    logInfo << "Step" << i << macro.at(i).kind << macro.at(i).path
+            << "took" << stepNs.at(i) / runs / 1000 << "us on average";
+  logInfo << "Replayed" << repetition << "times in" << totalNs / 1000000
+          << "ms";
+  emit finished(ok);
+  deleteLater();
+}
+
+} // namespace Tetradactyl
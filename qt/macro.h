@@ -0,0 +1,59 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QChar>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include "controller.h"
+
+namespace Tetradactyl {
+
+// Macros recorded with q<register>, shared by the windows of the application
+QHash<QChar, Macro> &macroRegisters();
+
+// Replays a macro a number of times without hints. Steps run one per pass of
+// the event loop, or ControllerSettings::macroStepDelayMs apart, so that the
+// windows and popups opened by a step are there for the next. Targets resolve
+// through the object path cache once for all repetitions, and a step whose
+// target doesn't exist or isn't visible yet is retried for up to
+// ControllerSettings::macroWaitTimeoutMs. The time of each step is logged at
+// the end.
+class MacroPlayer : public QObject {
+  Q_OBJECT
+public:
+  MacroPlayer(WindowController *controller, const Macro &macro, int count);
+  virtual ~MacroPlayer() {}
+
+  void start();
+  // time spent in each step, summed over the repetitions
+  const QVector<qint64> &stepNanoseconds() const;
+
+signals:
+  void finished(bool ok);
+
+private:
+  void runNextStep();
+  bool runStep(int i);
+  void finish(bool ok);
+
+  WindowController *windowController;
+  Macro macro;
+  QVector<AcceptTarget> targets;
+  int count;
+  int repetition = 0;
+  int step = 0;
+  QVector<qint64> stepNs;
+  QElapsedTimer elapsed;
+  // since the current step first failed to find its target
+  QElapsedTimer waiting;
+  QTimer next;
+};
+
+inline const QVector<qint64> &MacroPlayer::stepNanoseconds() const {
+  return stepNs;
+}
+
+} // namespace Tetradactyl
@@ -0,0 +1,91 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTextStream>
+
+#include <launcher/utils.h>
+
+#include "logging.h"
+#include "marks.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.marks", Qt::cyan);
+
+namespace Tetradactyl {
+
+MarkTable *MarkTable::instance() {
+  static MarkTable *self = new MarkTable;
+  self->load();
+  return self;
+}
+
+QString MarkTable::path() const {
+  QString dir = QStandardPaths::writableLocation(
+      QStandardPaths::GenericDataLocation);
+  return dir + QStringLiteral("/tetradactyl/marks/") +
+         QCoreApplication::applicationName() + QStringLiteral(".tsv");
+}
+
+// One "letter\tmode\tpath" line per mark. The file is small enough to read on
+// the first use of marks.
+void MarkTable::load() {
+  if (loaded || !Controller::settings.persistMarks)
+    return;
+  loaded = true;
+  QFile file(path());
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    return;
+  QTextStream stream(&file);
+  while (!stream.atEnd()) {
+    QStringList fields = stream.readLine().split(QLatin1Char('\t'));
+    if (fields.length() != 3 || fields.at(0).length() != 1)
+      continue;
+    AcceptTarget target;
+    target.mode = enumKeyToValue<HintMode>(fields.at(1));
+    if (enumValueToKey<HintMode>(target.mode) != fields.at(1))
+      continue;
+    target.path = fields.at(2);
+    // saved marks are resolved by path on first use
+    marks.insert(fields.at(0).at(0), target);
+  }
+  logInfo << "Loaded" << marks.size() << "marks from" << path();
+}
+
+void MarkTable::save() {
+  if (!Controller::settings.persistMarks)
+    return;
+  QString tablePath = path();
+  QDir().mkpath(QFileInfo(tablePath).absolutePath());
+  QSaveFile file(tablePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    logWarning << "Can't write marks" << tablePath;
+    return;
+  }
+  QTextStream stream(&file);
+  for (auto it = marks.begin(); it != marks.end(); ++it)
+    stream << it.key() << '\t' << enumValueToKey<HintMode>(it.value().mode)
+           << '\t' << it.value().path << '\n';
+  stream.flush();
+  if (!file.commit())
+    logWarning << "Can't write marks" << tablePath;
+}
+
+void MarkTable::set(QChar letter, const AcceptTarget &target) {
+  logInfo << "Mark" << letter << "at" << target.path;
+  marks.insert(letter, target);
+  save();
+}
+
+AcceptTarget *MarkTable::find(QChar letter) {
+  auto search = marks.find(letter);
+  return search != marks.end() ? &search.value() : nullptr;
+}
+
+void MarkTable::clear() { marks.clear(); }
+
+} // namespace Tetradactyl
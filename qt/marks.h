@@ -0,0 +1,43 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QChar>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+#include "controller.h"
+
+namespace Tetradactyl {
+
+// Vim-style marks: targets saved under a letter, to be accepted again without
+// hinting. A mark resolves through the QPointer of its widget until the widget
+// is destroyed, and then through its path. Marks are kept per application in
+// the data directory between runs.
+class MarkTable : public QObject {
+  Q_OBJECT
+public:
+  MarkTable(MarkTable &) = delete;
+  MarkTable &operator=(MarkTable &) = delete;
+  virtual ~MarkTable() {}
+
+  static MarkTable *instance();
+
+  void set(QChar letter, const AcceptTarget &target);
+  // nullptr if there's no mark of the letter
+  AcceptTarget *find(QChar letter);
+  int size() const;
+  QString path() const;
+  void load();
+  void save();
+  void clear();
+
+private:
+  MarkTable() {}
+
+  QHash<QChar, AcceptTarget> marks;
+  bool loaded = false;
+};
+
+inline int MarkTable::size() const { return marks.size(); }
+
+} // namespace Tetradactyl
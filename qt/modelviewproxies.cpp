@@ -23,6 +23,14 @@ bool QAbstractItemViewActionProxy::edit(EditAction *action) {
   return true;
 }
 
+QString QAbstractItemViewActionProxy::text() {
+  return modelIndex.data(Qt::DisplayRole).toString();
+}
+
+QString QAbstractItemViewActionProxy::objectPath() {
+  return modelIndexPath(widget, modelIndex);
+}
+
 bool QAbstractItemViewActionProxy::focus(FocusAction *action) {
   QAbstractItemView *instance = qobject_cast<QAbstractItemView *>(widget);
   instance->setCurrentIndex(this->modelIndex);
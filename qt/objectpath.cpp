@@ -0,0 +1,234 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QAbstractItemModel>
+#include <QAbstractItemView>
+#include <QApplication>
+#include <QLoggingCategory>
+#include <QStringList>
+
+#include "logging.h"
+#include "objectpath.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.objectpath", Qt::cyan);
+
+namespace Tetradactyl {
+
+// resolved paths kept
+static const int cacheSize = 256;
+
+ObjectPathCache *ObjectPathCache::self = nullptr;
+
+static QString ancestorStep(QWidget *w) {
+  QString step = QString::fromLatin1(w->metaObject()->className());
+  if (!w->objectName().isEmpty())
+    return step + QLatin1Char('#') + w->objectName();
+  QWidget *parent = w->parentWidget();
+  if (parent == nullptr)
+    return step;
+  int index = 0;
+  for (QObject *sibling : parent->children()) {
+    if (sibling == w)
+      break;
+    if (sibling->metaObject() == w->metaObject())
+      index++;
+  }
+  return step + QLatin1Char('[') + QString::number(index) + QLatin1Char(']');
+}
+
+QString widgetPath(QWidget *widget) {
+  QStringList steps;
+  for (QWidget *w = widget; w != nullptr; w = w->parentWidget()) {
+    steps.prepend(ancestorStep(w));
+    if (w->isWindow())
+      break;
+  }
+  return steps.join(QLatin1Char('/'));
+}
+
+QString tabPath(QTabBar *bar, int index) {
+  return widgetPath(bar) + QStringLiteral("|tab:") + QString::number(index);
+}
+
+QString modelIndexPath(QWidget *view, const QModelIndex &index) {
+  QStringList steps;
+  for (QModelIndex i = index; i.isValid(); i = i.parent())
+    steps.prepend(QString::number(i.row()) + QLatin1Char(',') +
+                  QString::number(i.column()));
+  return widgetPath(view) + QStringLiteral("|index:") +
+         steps.join(QLatin1Char('/'));
+}
+
+static QString actionName(QAction *action) {
+  if (!action->objectName().isEmpty())
+    return action->objectName();
+  return QString(action->text()).remove(QLatin1Char('&'));
+}
+
+QString actionPath(QWidget *widget, QAction *action) {
+  return widgetPath(widget) + QStringLiteral("|action:") + actionName(action);
+}
+
+// The child of the parent at the step, counting siblings as ancestorStep()
+static QWidget *childAtStep(QWidget *parent, const QString &step) {
+  QString className = step;
+  QString name;
+  int index = 0;
+  int hash = step.indexOf(QLatin1Char('#'));
+  int bracket = step.lastIndexOf(QLatin1Char('['));
+  if (hash >= 0) {
+    className = step.left(hash);
+    name = step.mid(hash + 1);
+  } else if (bracket >= 0 && step.endsWith(QLatin1Char(']'))) {
+    className = step.left(bracket);
+    index = step.mid(bracket + 1, step.length() - bracket - 2).toInt();
+  }
+  for (QObject *child : parent->children()) {
+    if (QLatin1String(child->metaObject()->className()) != className)
+      continue;
+    if (!name.isEmpty() ? child->objectName() == name : index-- == 0)
+      return qobject_cast<QWidget *>(child);
+  }
+  return nullptr;
+}
+
+// Whether the window is the scope, or one of the popups and dialogs it owns
+static bool inScope(QWidget *window, QWidget *scope) {
+  for (QWidget *w = window; w != nullptr; w = w->parentWidget())
+    if (w == scope)
+      return true;
+  return false;
+}
+
+// Decode the path from the top-level widgets down, one level at a time.
+// Windows of the same class and name are told apart by the rest of the path,
+// and only those of the scope are looked at, if any.
+static QWidget *decodeWidgetPath(const QString &path, QWidget *scope) {
+  QStringList steps = path.split(QLatin1Char('/'));
+  QString windowStep = steps.takeFirst();
+  for (QWidget *window : QApplication::topLevelWidgets()) {
+    if (ancestorStep(window) != windowStep ||
+        (scope != nullptr && !inScope(window, scope)))
+      continue;
+    QWidget *w = window;
+    for (const QString &step : steps) {
+      w = childAtStep(w, step);
+      if (w == nullptr)
+        break;
+    }
+    if (w != nullptr)
+      return w;
+  }
+  return nullptr;
+}
+
+static QModelIndex decodeModelIndex(QWidget *widget, const QString &steps) {
+  QAbstractItemView *view = qobject_cast<QAbstractItemView *>(widget);
+  if (view == nullptr || view->model() == nullptr)
+    return QModelIndex();
+  QModelIndex index;
+  for (const QString &step : steps.split(QLatin1Char('/'))) {
+    int comma = step.indexOf(QLatin1Char(','));
+    index = view->model()->index(step.left(comma).toInt(),
+                                 step.mid(comma + 1).toInt(), index);
+    if (!index.isValid())
+      break;
+  }
+  return index;
+}
+
+static QAction *decodeAction(QWidget *widget, const QString &name) {
+  for (QAction *action : widget->actions())
+    if (actionName(action) == name)
+      return action;
+  return nullptr;
+}
+
+ObjectPathCache *ObjectPathCache::instance() {
+  if (self == nullptr)
+    self = new ObjectPathCache;
+  return self;
+}
+
+void ObjectPathCache::forget(QObject *obj) {
+  if (self == nullptr || self->pathsOfWidgets.isEmpty())
+    return;
+  QString path = self->pathsOfWidgets.value(obj);
+  if (!path.isNull())
+    self->remove(path);
+}
+
+// The fragment of a pseudo-widget is resolved anew each time, since tabs and
+// items come and go without any widget being destroyed
+ObjectPathTarget ObjectPathCache::resolve(const QString &path,
+                                          QWidget *scope) {
+  ObjectPathTarget ret;
+  int bar = path.indexOf(QLatin1Char('|'));
+  ret.widget = resolveWidget(bar >= 0 ? path.left(bar) : path, scope);
+  if (ret.widget == nullptr || bar < 0)
+    return ret;
+
+  QString fragment = path.mid(bar + 1);
+  int colon = fragment.indexOf(QLatin1Char(':'));
+  QString kind = fragment.left(colon);
+  QString value = fragment.mid(colon + 1);
+  bool found = false;
+  if (kind == QLatin1String("tab")) {
+    QTabBar *tabBar = qobject_cast<QTabBar *>(ret.widget);
+    ret.tab = value.toInt();
+    found = tabBar != nullptr && ret.tab < tabBar->count();
+  } else if (kind == QLatin1String("index")) {
+    ret.index = decodeModelIndex(ret.widget, value);
+    found = ret.index.isValid();
+  } else if (kind == QLatin1String("action")) {
+    ret.action = decodeAction(ret.widget, value);
+    found = ret.action != nullptr;
+  }
+  if (!found) {
+    logDebug << "No" << fragment << "in" << ret.widget;
+    return ObjectPathTarget();
+  }
+  return ret;
+}
+
+// A cached widget out of the scope is decoded again and replaced
+QWidget *ObjectPathCache::resolveWidget(const QString &path, QWidget *scope) {
+  auto search = entries.find(path);
+  if (search != entries.end() && search->widget &&
+      (scope == nullptr || inScope(search->widget->window(), scope))) {
+    ages.splice(ages.begin(), ages, search->age);
+    return search->widget;
+  }
+  QWidget *widget = decodeWidgetPath(path, scope);
+  if (widget != nullptr)
+    insert(path, widget);
+  return widget;
+}
+
+void ObjectPathCache::insert(const QString &path, QWidget *widget) {
+  remove(path);
+  // a widget renamed since is cached under its new path only
+  remove(pathsOfWidgets.value(widget));
+  ages.push_front(path);
+  entries.insert(path, {widget, widget, ages.begin()});
+  pathsOfWidgets.insert(widget, path);
+  if (entries.size() > cacheSize) {
+    QString oldest = ages.back();
+    remove(oldest);
+  }
+}
+
+void ObjectPathCache::remove(const QString &path) {
+  auto search = entries.find(path);
+  if (search == entries.end())
+    return;
+  pathsOfWidgets.remove(search->object);
+  ages.erase(search->age);
+  entries.erase(search);
+}
+
+void ObjectPathCache::clear() {
+  entries.clear();
+  ages.clear();
+  pathsOfWidgets.clear();
+}
+
+} // namespace Tetradactyl
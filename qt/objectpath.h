@@ -0,0 +1,78 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QAction>
+#include <QHash>
+#include <QModelIndex>
+#include <QPointer>
+#include <QString>
+#include <QTabBar>
+#include <QWidget>
+
+#include <list>
+
+namespace Tetradactyl {
+
+// Object paths name widgets stably across runs: the class and object name or
+// sibling index of each ancestor from the window down, separated by '/', e.g.
+// "QMainWindow/QWidget#central/QPushButton[2]". Pseudo-widgets add a fragment
+// after '|': "tab:2" for a tab, "index:0,0/3,1" for the rows and columns of a
+// model index from the root down, and "action:Save" for the object name or
+// text of a menu action.
+QString widgetPath(QWidget *widget);
+QString tabPath(QTabBar *bar, int index);
+QString modelIndexPath(QWidget *view, const QModelIndex &index);
+QString actionPath(QWidget *widget, QAction *action);
+
+// What an object path resolves to. Only the part of the fragment is set.
+struct ObjectPathTarget {
+  QWidget *widget = nullptr;
+  int tab = -1;
+  QModelIndex index;
+  QAction *action = nullptr;
+};
+
+// Resolves object paths to widgets. A path is decoded a step at a time by
+// looking at the children of each ancestor, and the widget is then kept in an
+// LRU cache, so that resolving the path again is a hash lookup. Entries are
+// dropped when their widget is destroyed, as told by the remove hook of the
+// ObjectProbe. A widget renamed or moved keeps its cached path until then.
+class ObjectPathCache {
+public:
+  ObjectPathCache(ObjectPathCache &) = delete;
+  ObjectPathCache &operator=(ObjectPathCache &) = delete;
+
+  static ObjectPathCache *instance();
+  // called for every destroyed QObject, so cheap while the cache is empty
+  static void forget(QObject *obj);
+
+  // Only the windows of the scope, and those they own, are searched, unless
+  // it's null
+  ObjectPathTarget resolve(const QString &path, QWidget *scope = nullptr);
+  int size() const;
+  void clear();
+
+private:
+  ObjectPathCache() {}
+
+  QWidget *resolveWidget(const QString &path, QWidget *scope);
+  void insert(const QString &path, QWidget *widget);
+  void remove(const QString &path);
+
+  struct Entry {
+    QPointer<QWidget> widget;
+    // key in pathsOfWidgets, kept past the destruction of the widget
+    QObject *object;
+    // position in ages
+    std::list<QString>::iterator age;
+  };
+  QHash<QString, Entry> entries;
+  // paths from the most to the least recently resolved
+  std::list<QString> ages;
+  QHash<QObject *, QString> pathsOfWidgets;
+
+  static ObjectPathCache *self;
+};
+
+inline int ObjectPathCache::size() const { return entries.size(); }
+
+} // namespace Tetradactyl
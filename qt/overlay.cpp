@@ -1,15 +1,20 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QLabel>
 #include <QLayoutItem>
 #include <QLoggingCategory>
 #include <QPainter>
+#include <QPen>
 #include <QStringLiteral>
+#include <QTimer>
+#include <QtMath>
 
 #include <qobject.h>
 
 #include <algorithm>
-#include <iterator>
+#include <limits>
+#include <numeric>
 
 #include <launcher/utils.h>
 
@@ -20,29 +25,128 @@
 #include "hint.h"
 #include "logging.h"
 #include "overlay.h"
-
-using std::copy_if;
+#include "pixmapcache.h"
 
 LOGGING_CATEGORY_COLOR("tetradactyl.overlay", Qt::yellow);
 
 namespace Tetradactyl {
 
+// interval of the tracer clock while fading
+static const int tracerFrameMs = 16;
+// resize-driven relayouts happen at most once per this interval
+static const int relayoutFrameMs = 16;
+
+// Single clock driving the tracers of all overlays. It ticks per frame only
+// while some tracer fades, and otherwise just once at the earliest expiry.
+class TracerClock {
+public:
+  static TracerClock *instance();
+  qint64 now() { return elapsed.elapsed(); }
+  void add(Overlay *overlay);
+  void remove(Overlay *overlay);
+
+private:
+  TracerClock();
+  void tick();
+  void schedule(qint64 remainingMs);
+
+  QElapsedTimer elapsed;
+  QTimer timer;
+  QList<Overlay *> overlays;
+};
+
+TracerClock::TracerClock() {
+  elapsed.start();
+  timer.setSingleShot(true);
+  QObject::connect(&timer, &QTimer::timeout, [this]() { tick(); });
+}
+
+TracerClock *TracerClock::instance() {
+  static TracerClock *self = new TracerClock;
+  return self;
+}
+
+void TracerClock::add(Overlay *overlay) {
+  if (!overlays.contains(overlay))
+    overlays.append(overlay);
+  schedule(Controller::settings.highlightAcceptedHintMs);
+}
+
+void TracerClock::remove(Overlay *overlay) {
+  overlays.removeOne(overlay);
+  if (overlays.isEmpty())
+    timer.stop();
+}
+
+void TracerClock::tick() {
+  qint64 nowMs = now();
+  qint64 nextMs = std::numeric_limits<qint64>::max();
+  for (int i = overlays.length() - 1; i >= 0; --i) {
+    qint64 remainingMs = overlays.at(i)->tickTracer(nowMs);
+    if (remainingMs <= 0)
+      overlays.removeAt(i);
+    else
+      nextMs = std::min(nextMs, remainingMs);
+  }
+  if (!overlays.isEmpty())
+    schedule(nextMs);
+}
+
+void TracerClock::schedule(qint64 remainingMs) {
+  int interval = Controller::settings.fadeAcceptedHint
+                     ? tracerFrameMs
+                     : static_cast<int>(remainingMs);
+  if (!timer.isActive() || timer.remainingTime() > interval)
+    timer.start(interval);
+}
+
+OverlaySurface::OverlaySurface(Overlay *_overlay, QWidget *host)
+    : QWidget(host, Qt::Tool | Qt::FramelessWindowHint |
+                        Qt::WindowTransparentForInput |
+                        Qt::WindowDoesNotAcceptFocus),
+      overlay(_overlay) {
+  setAttribute(Qt::WA_TranslucentBackground);
+  setAttribute(Qt::WA_ShowWithoutActivating);
+  setAttribute(Qt::WA_TransparentForMouseEvents);
+  syncGeometry();
+}
+
+void OverlaySurface::syncGeometry() {
+  QWidget *host = parentWidget();
+  setGeometry(QRect(host->mapToGlobal(QPoint(0, 0)), host->size()));
+}
+
+void OverlaySurface::paintEvent(QPaintEvent *) {
+  if (overlay->hasPointerGrid()) {
+    QPainter painter(this);
+    overlay->paintPointerGrid(painter);
+  }
+  if (overlay->hasTracer()) {
+    QPainter painter(this);
+    overlay->paintTracer(painter);
+  }
+}
+
 // target need not be the target of the  WindowController
 Overlay::Overlay(WindowController *windowController, QWidget *target,
                  bool isMain)
-    : QWidget(target), controller(windowController), p_selectedHint(nullptr),
-      p_statusIndicator(nullptr), p_commandLine(nullptr) {
+    : QWidget(target), controller(windowController), surface(nullptr),
+      offsets(target), p_selectedHint(nullptr), p_statusIndicator(nullptr),
+      p_commandLine(nullptr) {
   Q_ASSERT(controller != nullptr);
   Q_ASSERT(target != nullptr);
   // Since Overlay is not in any layout, this is needed.
   setFixedSize(2000, 2000);
   setAttribute(Qt::WA_TransparentForMouseEvents);
 
+  attachSurface();
+  hintIndex.setAlphabet(QString::fromLatin1(Controller::settings.hintChars));
+
   // only make status indicator and command line for main overlays
   if (isMain) {
     p_statusIndicator = new QLabel(
         enumValueToKey<ControllerMode>(windowController->controllerMode()),
-        this);
+        hintParent());
     p_statusIndicator->setObjectName("overlay_status_indicator");
     p_statusIndicator->setStyleSheet(promptStylesheet);
     connect(windowController, &WindowController::modeChanged, p_statusIndicator,
@@ -56,19 +160,41 @@ Overlay::Overlay(WindowController *windowController, QWidget *target,
             });
 
     p_commandLine = new CommandLine(this);
+    // With a surface, the overlay is only shown in the host for the command
+    // line, so that hinting never dirties the host
+    connect(p_commandLine, &CommandLine::opened, this, [this] {
+      if (surface)
+        show();
+    });
+    connect(p_commandLine, &CommandLine::closed, this, [this] {
+      if (surface)
+        hide();
+    });
   }
 
   setLayout(new OverlayLayout(this));
 
-  show();
+  relayoutTimer.setSingleShot(true);
+  relayoutTimer.setInterval(relayoutFrameMs);
+  connect(&relayoutTimer, &QTimer::timeout, this, [this]() {
+    offsets.clear();
+    // hints move with their targets
+    spatialIndex.clear();
+    layout()->update();
+  });
+
+  setVisible(!surface);
 }
 
 // n.b. This does not include the "tracer" hint is displayed  for a short period
 // after hinting has finished
+// in reading order, as Tab goes
 QList<HintLabel *> Overlay::visibleHints() {
   QList<HintLabel *> ret;
-  copy_if(p_hints.begin(), p_hints.end(), std::back_inserter(ret),
-          [](HintLabel *hint) { return hint->isVisible(); });
+  int count = hintIndex.visibleCount();
+  ret.reserve(count);
+  for (int i = 0; i != count; ++i)
+    ret.append(hintIndex.visibleAt(i));
   return ret;
 }
 
@@ -77,33 +203,249 @@ void Overlay::addHint(QString text, QWidgetActionProxy *widgetProxy) {
       new HintLabel(text, widgetProxy->widget, this, widgetProxy);
   overlayLayout()->addHint(newHint);
   p_hints.append(newHint);
+  hintIndex.add(newHint);
+  spatialIndex.clear();
+  // The layout isn't activated by showing children of the surface
+  newHint->setGeometry(
+      QRect(newHint->positionInOverlay(), newHint->sizeHint()));
   newHint->show();
-  update();
+  hintParent()->update();
+}
+
+void Overlay::addHints(const QList<QWidgetActionProxy *> &proxies,
+                       const char *hintChars, const QVector<double> &weights) {
+  if (weights.isEmpty())
+    codes.generate(hintChars, proxies.length(),
+                   Controller::settings.hintCodeStyle);
+  else
+    codes.generate(hintChars, weights);
+  for (int i = 0; i != proxies.length(); ++i)
+    addHint(QString(codes[i]), proxies.at(i));
+}
+
+void Overlay::attachSurface() {
+  if (!Controller::settings.nativeOverlaySurface)
+    return;
+  surface = new OverlaySurface(this, host());
+  host()->installEventFilter(this);
+  if (host()->isVisible())
+    surface->show();
+}
+
+// Move the overlay onto another host, or detach it for pooling when newHost is
+// nullptr. Only overlays without chrome, i.e. those of popups, are moved.
+void Overlay::setHost(QWidget *newHost) {
+  Q_ASSERT(!isMain());
+  clear();
+  relayoutTimer.stop();
+  if (host() != nullptr)
+    host()->removeEventFilter(this);
+  delete surface.data();
+  surface = nullptr;
+  // a pooled overlay may still be showing the tracer of its last stage
+  if (newHost != nullptr && hasTracer()) {
+    TracerClock::instance()->remove(this);
+    tracer.startMs = -1;
+  }
+  setParent(newHost);
+  offsets = WidgetOffsetTable(newHost);
+  if (newHost != nullptr) {
+    attachSurface();
+    setVisible(!surface);
+  }
+}
+
+// Rough footprint of the overlay: its widgets and the surface's backing store
+size_t Overlay::approximateBytes() {
+  size_t ret = sizeof(Overlay) + sizeof(OverlayLayout) +
+               p_hints.length() * sizeof(HintLabel);
+  if (p_statusIndicator)
+    ret += sizeof(QLabel);
+  if (p_commandLine)
+    ret += sizeof(CommandLine);
+  if (surface && surface->isVisible())
+    ret += size_t(surface->width()) * surface->height() * 4;
+  return ret;
+}
+
+// Called on each resize of the host, which come in bursts while the user drags
+// the window edge. Overlays of popups without hints have nothing to lay out.
+void Overlay::scheduleRelayout() {
+  if (p_hints.isEmpty() && p_statusIndicator == nullptr)
+    return;
+  if (!relayoutTimer.isActive())
+    relayoutTimer.start();
+}
+
+Overlay::~Overlay() {
+  if (hasTracer())
+    TracerClock::instance()->remove(this);
+  delete surface.data();
+}
+
+// Take over the position and text of the hint being accepted. The hint itself
+// can then be deleted along with the rest.
+void Overlay::showTracer(HintLabel *hint) {
+  if (hasTracer())
+    hintParent()->update(tracer.rect);
+  tracer.text = hint->text();
+  tracer.font = hint->font();
+  tracer.rect = hint->geometry();
+  tracer.startMs = TracerClock::instance()->now();
+  TracerClock::instance()->add(this);
+  hintParent()->update(tracer.rect);
+}
+
+void Overlay::paintTracer(QPainter &painter) {
+  if (Controller::settings.fadeAcceptedHint) {
+    qreal progress = qreal(TracerClock::instance()->now() - tracer.startMs) /
+                     qMax(1, Controller::settings.highlightAcceptedHintMs);
+    painter.setOpacity(qBound(0.0, 1.0 - progress, 1.0));
+  }
+  painter.drawPixmap(tracer.rect.topLeft(),
+                     HintPixmapCache::instance()->pixmap(
+                         tracer.text, HintState::Accepted, tracer.font,
+                         hintParent()->devicePixelRatioF()));
+}
+
+// Called by the tracer clock. Returns the remaining lifetime of the tracer.
+qint64 Overlay::tickTracer(qint64 nowMs) {
+  qint64 remainingMs =
+      tracer.startMs + Controller::settings.highlightAcceptedHintMs - nowMs;
+  if (remainingMs <= 0)
+    tracer.startMs = -1;
+  if (remainingMs <= 0 || Controller::settings.fadeAcceptedHint)
+    hintParent()->update(tracer.rect);
+  return remainingMs;
+}
+
+void Overlay::paintEvent(QPaintEvent *) {
+  if (!surface && hasPointerGrid()) {
+    QPainter painter(this);
+    paintPointerGrid(painter);
+  }
+  if (!surface && hasTracer()) {
+    QPainter painter(this);
+    paintTracer(painter);
+  }
+}
+
+// The grid has about as many columns as rows, with one subcell per hint
+// character, so that each key divides the area by their number and any pixel
+// is reached in O(log area) keys.
+void Overlay::showPointerGrid() {
+  QString chars = QString::fromLatin1(Controller::settings.hintChars);
+  // Both sides are split in two at least, so that each key narrows the cell
+  // both ways. It's wider than tall, as windows mostly are.
+  int rows = qFloor(qSqrt(chars.length()));
+  pointerGrid.rows = rows;
+  pointerGrid.columns = chars.length() / rows;
+  pointerGrid.labels = chars.left(pointerGrid.columns * pointerGrid.rows);
+  pointerGrid.cell = QRect(QPoint(0, 0), host()->size());
+  pointerGrid.history.clear();
+  hintParent()->update();
+}
+
+void Overlay::hidePointerGrid() {
+  pointerGrid = PointerGrid();
+  hintParent()->update();
+}
+
+QRect Overlay::pointerSubcell(int i) const {
+  const QRect &cell = pointerGrid.cell;
+  int row = i / pointerGrid.columns;
+  int column = i % pointerGrid.columns;
+  int left = cell.left() + column * cell.width() / pointerGrid.columns;
+  int right = cell.left() + (column + 1) * cell.width() / pointerGrid.columns;
+  int top = cell.top() + row * cell.height() / pointerGrid.rows;
+  int bottom = cell.top() + (row + 1) * cell.height() / pointerGrid.rows;
+  // cells of a pixel don't divide further
+  return QRect(QPoint(left, top),
+               QPoint(qMax(left, right - 1), qMax(top, bottom - 1)));
+}
+
+bool Overlay::narrowPointerGrid(QChar label) {
+  int i = pointerGrid.labels.indexOf(label.toUpper());
+  if (!hasPointerGrid() || i < 0)
+    return false;
+  pointerGrid.history.append(pointerGrid.cell);
+  pointerGrid.cell = pointerSubcell(i);
+  hintParent()->update();
+  return true;
+}
+
+void Overlay::widenPointerGrid() {
+  if (pointerGrid.history.isEmpty())
+    return;
+  pointerGrid.cell = pointerGrid.history.takeLast();
+  hintParent()->update();
+}
+
+void Overlay::paintPointerGrid(QPainter &painter) {
+  painter.save();
+  painter.setPen(QPen(QColor(255, 200, 0), 1));
+  painter.setBrush(QColor(255, 200, 0, 32));
+  painter.drawRect(pointerGrid.cell);
+  painter.setBrush(Qt::NoBrush);
+  for (int i = 0; i != pointerSubcellCount(); ++i) {
+    QRect subcell = pointerSubcell(i);
+    painter.drawRect(subcell);
+    if (subcell.width() > 8 && subcell.height() > 8)
+      painter.drawText(subcell, Qt::AlignCenter, pointerGrid.labels.at(i));
+  }
+  QPoint center = pointerPosition();
+  painter.drawLine(center - QPoint(4, 0), center + QPoint(4, 0));
+  painter.drawLine(center - QPoint(0, 4), center + QPoint(0, 4));
+  painter.restore();
 }
 
-Overlay::~Overlay() {}
+// Keep the surface glued to the host
+bool Overlay::eventFilter(QObject *obj, QEvent *ev) {
+  if (obj == host() && surface) {
+    switch (ev->type()) {
+    case QEvent::Move:
+    case QEvent::Resize:
+      surface->syncGeometry();
+      break;
+    case QEvent::Show:
+      surface->syncGeometry();
+      surface->show();
+      break;
+    case QEvent::Hide:
+      surface->hide();
+      break;
+    default:
+      break;
+    }
+  }
+  return false;
+}
 
+// Step through the visible hints in reading order
 void Overlay::nextHint(bool forward) {
-  Q_ASSERT(p_hints.length() > 0);
-  int idx = p_hints.indexOf(selectedHint());
-  if (idx < 0) {
-    Q_ASSERT(p_selectedHint == nullptr);
-    p_selectedHint = p_hints.at(0);
-  } else {
+  HintLabel *next = hintIndex.step(forward);
+  if (next == nullptr)
+    return;
+  if (p_selectedHint != nullptr)
     p_selectedHint->setSelected(false);
-    Q_ASSERT(idx < p_hints.length());
-    int step = forward ? 1 : -1;
-    do {
-      idx += step;
-      if (idx == p_hints.length())
-        idx = 0;
-      else if (idx < 0)
-        idx = p_hints.length() - 1;
-      p_selectedHint = p_hints.at(idx);
-    } while (!p_selectedHint->isVisible());
-  }
+  p_selectedHint = next;
   p_selectedHint->setSelected(true);
-  update();
+  hintParent()->update();
+}
+
+void Overlay::moveSelection(Direction direction) {
+  if (p_selectedHint == nullptr) {
+    resetSelection();
+    return;
+  }
+  if (spatialIndex.isEmpty())
+    spatialIndex.build(p_hints);
+  HintLabel *next =
+      spatialIndex.nearest(p_selectedHint->positionInOverlay(), direction);
+  if (next == nullptr)
+    return;
+  resetSelection(next);
+  hintParent()->update();
 }
 
 void Overlay::resetSelection(HintLabel *label) {
@@ -117,24 +459,38 @@ void Overlay::resetSelection(HintLabel *label) {
     p_selectedHint = p_hints.at(0);
     p_selectedHint->setSelected(true);
   }
-}
-
-void Overlay::popHint(HintLabel *hint) {
-  Q_ASSERT(hint->parentWidget() == this);
-  int idx = p_hints.indexOf(hint);
-  Q_ASSERT(idx >= 0);
-  p_hints.removeAt(idx);
-  hint->setParent(parentWidget());
-  update();
+  hintIndex.select(p_selectedHint);
 }
 
 void Overlay::clear() {
+  // hints on the surface aren't children of the overlay, so the layout isn't
+  // told when they're deleted
+  overlayLayout()->clearHints();
   for (auto hint : p_hints) {
     delete hint;
   }
   p_hints.clear();
+  hintIndex.clear();
+  spatialIndex.clear();
+  // settings may have changed since
+  hintIndex.setAlphabet(QString::fromLatin1(Controller::settings.hintChars));
   p_selectedHint = nullptr;
-  update();
+  offsets.clear();
+  hintParent()->update();
+}
+
+// The codes of the other hints stay as they are, so that nothing moves under
+// the eyes of the user
+void Overlay::removeHint(HintLabel *hint) {
+  if (!p_hints.removeOne(hint))
+    return;
+  overlayLayout()->removeHint(hint);
+  hintIndex.remove(hint);
+  spatialIndex.clear();
+  if (p_selectedHint == hint)
+    p_selectedHint = nullptr;
+  delete hint;
+  hintParent()->update();
 }
 
 HintLabel *Overlay::selectedHint() { return p_selectedHint; }
@@ -142,31 +498,97 @@ QWidget *Overlay::selectedWidget() {
   return p_selectedHint != nullptr ? p_selectedHint->target : nullptr;
 }
 
-// Update hint visibility. Return number of visible hints.
-int Overlay::updateHints(QString &buffer) {
-  int numHintsVisible = 0;
-  for (auto hint : p_hints) {
-    if (hint->text().startsWith(buffer)) {
-      numHintsVisible++;
-      hint->show();
-    } else {
-      hint->hide();
+// The text and reading order of the hints are found once per discovery
+void Overlay::startTextFilter() {
+  QStringList texts;
+  texts.reserve(p_hints.length());
+  for (auto hint : p_hints)
+    texts.append(hint->proxy->text());
+  textIndex.reset(texts);
+  textReadingOrder.resize(p_hints.length());
+  std::iota(textReadingOrder.begin(), textReadingOrder.end(), 0);
+  std::stable_sort(textReadingOrder.begin(), textReadingOrder.end(),
+                   [this](int a, int b) {
+                     QPoint p = p_hints.at(a)->positionInOverlay();
+                     QPoint q = p_hints.at(b)->positionInOverlay();
+                     if (p.y() != q.y())
+                       return p.y() < q.y();
+                     return p.x() < q.x();
+                   });
+  hintIndex.setAlphabet(
+      QString::fromLatin1(Controller::settings.filteredHintChars));
+  relabelTextMatches();
+}
+
+int Overlay::pushTextFilter(QChar ch) {
+  textIndex.push(ch);
+  return relabelTextMatches();
+}
+
+int Overlay::popTextFilter() {
+  textIndex.pop();
+  return relabelTextMatches();
+}
+
+// Show only the hints whose text matches, and give them the shortest codes
+// over filteredHintChars, in discovery order. The codes come out in the order
+// of the index and the reading order is known, so nothing is sorted per key,
+// and only labels whose match or code changed are touched.
+int Overlay::relabelTextMatches() {
+  const QVector<int> &matches = textIndex.survivors();
+  if (p_selectedHint != nullptr)
+    p_selectedHint->setSelected(false);
+  p_selectedHint = nullptr;
+
+  codes.generate(Controller::settings.filteredHintChars, matches.length(),
+                 Controller::settings.hintCodeStyle);
+  // rank of each hint among the matches, or -1
+  std::vector<int> rank(p_hints.length(), -1);
+  QVector<HintLabel *> matched;
+  matched.reserve(matches.length());
+  for (int next = 0; next != matches.length(); ++next) {
+    int i = matches.at(next);
+    HintLabel *hint = p_hints.at(i);
+    QLatin1String code = codes[next];
+    if (hint->text() != code) {
+      hint->setText(QString(code));
+      hint->resize(hint->sizeHint());
     }
+    rank[i] = next;
+    matched.append(hint);
   }
-  if (!p_selectedHint->isVisible()) {
+  std::vector<int> readingOrder;
+  readingOrder.reserve(matches.length());
+  for (int i : textReadingOrder) {
+    bool isMatch = rank[i] >= 0;
+    HintLabel *hint = p_hints.at(i);
+    if (hint->isHidden() == isMatch)
+      hint->setVisible(isMatch);
+    if (isMatch)
+      readingOrder.push_back(rank[i]);
+  }
+  hintIndex.reset(matched, std::move(readingOrder));
+  if (!matches.isEmpty())
+    resetSelection(p_hints.at(matches.first()));
+  return matches.length();
+}
+
+// Update hint visibility. Return number of visible hints.
+// Labels toggled by the index schedule their own repaints, so the overlay
+// itself needn't be updated.
+int Overlay::updateHints(QString &buffer) {
+  hintIndex.filter(buffer);
+  int numHintsVisible = hintIndex.visibleCount();
+  if (p_selectedHint == nullptr || p_selectedHint->isHidden()) {
     // Reset the selected hint to the first visible one, if possible.
     if (numHintsVisible == 0) {
+      if (p_selectedHint != nullptr)
+        p_selectedHint->setSelected(false);
       p_selectedHint = nullptr;
     } else {
-      for (auto hint : p_hints) {
-        if (hint->isVisible()) {
-          resetSelection(hint);
-          break;
-        }
-      }
+      resetSelection(hintIndex.firstVisible());
     }
   }
-  update();
 
   return numHintsVisible;
 }
@@ -216,14 +638,31 @@ int OverlayLayout::count() const { return items.length(); }
 void OverlayLayout::addHint(HintLabel *hint) { addItem(new QWidgetItem(hint)); }
 void OverlayLayout::addItem(QLayoutItem *item) { items.append(item); }
 
+void OverlayLayout::removeHint(HintLabel *hint) {
+  for (int i = 0; i != items.length(); ++i) {
+    if (items.at(i)->widget() == hint) {
+      delete items.takeAt(i);
+      return;
+    }
+  }
+}
+
+void OverlayLayout::clearHints() {
+  qDeleteAll(items);
+  items.clear();
+}
+
 // Perform the layout. Must make sure that hints don't occlude one another or
 // escape the window geometry here.
 void OverlayLayout::setGeometry(const QRect &updateRect) {
   QRect hostGeometry = overlay()->parentWidget()->geometry();
+  QRect hostRect(QPoint(0, 0), hostGeometry.size());
   for (auto item : items) {
-    HintLabel *hint = qobject_cast<HintLabel *>(item->widget());
+    HintLabel *hint = static_cast<HintLabel *>(item->widget());
+    hint->p_positionInOverlay =
+        overlay()->offsetOf(hint->target) + hint->positionInTarget();
     QRect hintGeometry = QRect(hint->positionInOverlay(), hint->sizeHint());
-    if (!hintGeometry.intersects(hintGeometry)) {
+    if (!hintGeometry.intersects(hostRect)) {
       logWarning << "Creating hint " << hint << "at" << hintGeometry
                  << "which doesn't intersect overlay host geometry"
                  << hostGeometry;
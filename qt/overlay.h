@@ -1,12 +1,24 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
 #pragma once
+#include <QFont>
 #include <QLabel>
 #include <QLayout>
+#include <QPainter>
+#include <QPointer>
+#include <QRect>
 #include <QString>
+#include <QTimer>
+#include <QVector>
 #include <QWidget>
 #include <qlist.h>
 
+#include <vector>
+
 #include "common.h"
+#include "controller.h"
+#include "fuzzy.h"
+#include "hintindex.h"
+#include "spatialindex.h"
 
 namespace Tetradactyl {
 
@@ -20,6 +32,48 @@ class WindowController;
 QList<HintLabel *> findHintsByTargetHelper(Overlay *overlay,
                                            const QMetaObject *mo);
 
+// Transparent top-level window stacked above the host, onto which the hints and
+// status indicator of an Overlay are drawn when
+// ControllerSettings::nativeOverlaySurface is set. It has its own backing
+// store, so showing and hiding hints doesn't invalidate the host's and
+// expensive client widgets under the hints aren't repainted.
+class OverlaySurface : public QWidget {
+  Q_OBJECT
+public:
+  OverlaySurface(Overlay *overlay, QWidget *host);
+  virtual ~OverlaySurface() {}
+
+  void syncGeometry();
+
+protected:
+  void paintEvent(QPaintEvent *) override;
+
+private:
+  Overlay *overlay;
+};
+
+// The accepted hint, which lingers for highlightAcceptedHintMs after
+// acceptance. It's painted by its Overlay from the cached pixmap instead of
+// being a widget, so accepting doesn't reparent or repolish anything.
+struct Tracer {
+  QString text;
+  QFont font;
+  QRect rect;
+  // start time on the shared tracer clock, negative when inactive
+  qint64 startMs = -1;
+};
+
+// Cell of the host narrowed down in Pointer mode. The overlay paints it as a
+// grid of subcells labelled with the hint characters, without child widgets.
+struct PointerGrid {
+  QRect cell;
+  // cells before each narrowing
+  QVector<QRect> history;
+  int columns = 0;
+  int rows = 0;
+  QString labels;
+};
+
 class Overlay : public QWidget {
   Q_OBJECT
 public:
@@ -38,7 +92,34 @@ public:
   OverlayLayout *overlayLayout();
 
   QWidget *host();
+  void setHost(QWidget *host);
+  // main overlays carry the status indicator and command line
+  bool isMain() const;
+  size_t approximateBytes();
+  // widget the HintLabels and status indicator are children of: this or the
+  // OverlaySurface
+  QWidget *hintParent();
   const QList<HintLabel *> &hints();
+  // offset of w from the host, memoized until the next relayout
+  QPoint offsetOf(QWidget *w);
+  void scheduleRelayout();
+  void showTracer(HintLabel *hint);
+  bool hasTracer() const;
+  void paintTracer(QPainter &painter);
+  qint64 tickTracer(qint64 nowMs);
+  void showPointerGrid();
+  void hidePointerGrid();
+  bool hasPointerGrid() const;
+  // Narrow the cell down to the subcell of the label, if it's one
+  bool narrowPointerGrid(QChar label);
+  void widenPointerGrid();
+  QRect pointerCell() const;
+  QRect pointerSubcell(int i) const;
+  int pointerSubcellCount() const;
+  QString pointerLabels() const;
+  // center of the cell, in host coordinates
+  QPoint pointerPosition() const;
+  void paintPointerGrid(QPainter &painter);
   const QLabel *statusIndicator();
   CommandLine *commandLine();
   QList<HintLabel *> visibleHints();
@@ -47,11 +128,22 @@ public:
 
 public slots:
   void addHint(QString text, QWidgetActionProxy *widgetProxy);
-  void popHint(HintLabel *hint);
+  // hint the proxies, the first or the heaviest ones with the shortest codes
+  void addHints(const QList<QWidgetActionProxy *> &proxies,
+                const char *hintChars,
+                const QVector<double> &weights = QVector<double>());
   void clear();
+  // drop one hint, e.g. the accepted one of continuous hinting
+  void removeHint(HintLabel *hint);
   int updateHints(QString &);
+  // filtered hinting: returns the number of hints matching the text
+  void startTextFilter();
+  int pushTextFilter(QChar ch);
+  int popTextFilter();
   void resetSelection(HintLabel *label = nullptr);
   void nextHint(bool forward);
+  // select the nearest hint in the direction of the selected one
+  void moveSelection(Direction direction);
 
 public:
   template <typename T> inline QList<HintLabel *> findHintsByTarget() {
@@ -59,9 +151,29 @@ public:
     return findHintsByTargetHelper(this, &ObjType::staticMetaObject);
   }
 
+protected:
+  bool eventFilter(QObject *obj, QEvent *ev) override;
+  void paintEvent(QPaintEvent *) override;
+
 private:
+  void attachSurface();
+  int relabelTextMatches();
+
   WindowController *controller;
+  // a child of the host as well, which may delete it first
+  QPointer<OverlaySurface> surface;
+  Tracer tracer;
+  PointerGrid pointerGrid;
+  WidgetOffsetTable offsets;
+  QTimer relayoutTimer;
   QList<HintLabel *> p_hints;
+  HintIndex hintIndex;
+  // built on the first move of a hinting
+  SpatialIndex spatialIndex;
+  FuzzyIndex textIndex;
+  // indices into p_hints in reading order, while filtering by text
+  std::vector<int> textReadingOrder;
+  HintGenerator codes;
   HintLabel *p_selectedHint;
   QLabel *p_statusIndicator;
   CommandLine *p_commandLine;
@@ -72,7 +184,22 @@ private:
 };
 
 inline QWidget *Overlay::host() { return parentWidget(); }
+inline bool Overlay::isMain() const { return p_statusIndicator != nullptr; }
+inline QWidget *Overlay::hintParent() {
+  return surface ? static_cast<QWidget *>(surface.data()) : this;
+}
 inline const QList<HintLabel *> &Overlay::hints() { return p_hints; }
+inline bool Overlay::hasTracer() const { return tracer.startMs >= 0; }
+inline bool Overlay::hasPointerGrid() const { return pointerGrid.rows > 0; }
+inline QRect Overlay::pointerCell() const { return pointerGrid.cell; }
+inline QString Overlay::pointerLabels() const { return pointerGrid.labels; }
+inline int Overlay::pointerSubcellCount() const {
+  return pointerGrid.rows * pointerGrid.columns;
+}
+inline QPoint Overlay::pointerPosition() const {
+  return pointerGrid.cell.center();
+}
+inline QPoint Overlay::offsetOf(QWidget *w) { return offsets.offset(w); }
 inline const QLabel *Overlay::statusIndicator() { return p_statusIndicator; }
 inline CommandLine *Overlay::commandLine() { return p_commandLine; }
 
@@ -84,6 +211,8 @@ public:
 
   int count() const override;
   void addHint(HintLabel *hint);
+  void removeHint(HintLabel *hint);
+  void clearHints();
   void addItem(QLayoutItem *) override;
   void setGeometry(const QRect &) override;
   QLayoutItem *itemAt(int index) const override;
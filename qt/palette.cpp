@@ -0,0 +1,233 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QApplication>
+#include <QKeySequence>
+#include <QLoggingCategory>
+#include <QMenu>
+#include <QStringList>
+#include <QWidget>
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#include "common.h"
+#include "logging.h"
+#include "palette.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.palette", Qt::green);
+
+namespace Tetradactyl {
+
+// results shown at once
+static const int maxResults = 10;
+// bound on nesting of menus, against cycles
+static const int maxMenuDepth = 8;
+
+ActionIndex *ActionIndex::self = nullptr;
+
+static QList<QWidget *> associatedWidgets(QAction *action) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  QList<QWidget *> ret;
+  for (QObject *obj : action->associatedObjects())
+    if (obj->isWidgetType())
+      ret.append(static_cast<QWidget *>(obj));
+  return ret;
+#else
+  return action->associatedWidgets();
+#endif
+}
+
+static QString plainText(const QString &text) {
+  return QString(text).remove(QLatin1Char('&'));
+}
+
+// The action as searched and shown: the titles of the menus leading to it, its
+// text and its shortcut, or nothing if it can't be triggered. The window is
+// the one of the menu bar, tool bar or widget that the menus hang from.
+static QString describe(QAction *action, QWidget **window) {
+  *window = nullptr;
+  if (action->isSeparator() || action->menu() != nullptr ||
+      action->text().isEmpty())
+    return QString();
+  QStringList steps(plainText(action->text()));
+  QAction *step = action;
+  for (int depth = 0; depth != maxMenuDepth; ++depth) {
+    QMenu *menu = nullptr;
+    for (QWidget *w : associatedWidgets(step)) {
+      if (qobject_cast<QMenu *>(w) != nullptr)
+        menu = static_cast<QMenu *>(w);
+      else if (*window == nullptr)
+        *window = w->window();
+    }
+    if (menu == nullptr)
+      break;
+    if (!menu->title().isEmpty())
+      steps.prepend(plainText(menu->title()));
+    // context menus hang from the widget they're made for
+    if (*window == nullptr && menu->parentWidget() != nullptr)
+      *window = menu->parentWidget()->window();
+    step = menu->menuAction();
+  }
+  if (*window == nullptr && action->parent() != nullptr &&
+      action->parent()->isWidgetType())
+    *window = static_cast<QWidget *>(action->parent())->window();
+  QString ret = steps.join(QStringLiteral(" > "));
+  if (!action->shortcut().isEmpty())
+    ret += QStringLiteral("  ") +
+           action->shortcut().toString(QKeySequence::NativeText);
+  return ret;
+}
+
+// Actions which existed before the index are found once through the widgets
+ActionIndex::ActionIndex() {
+  for (QWidget *widget : QApplication::allWidgets())
+    for (QAction *action : widget->actions())
+      add(action);
+}
+
+ActionIndex *ActionIndex::instance() {
+  if (self == nullptr)
+    self = new ActionIndex;
+  return self;
+}
+
+void ActionIndex::forget(QObject *obj) {
+  if (self == nullptr)
+    return;
+  auto search = self->indices.find(obj);
+  if (search == self->indices.end())
+    return;
+  int i = search.value();
+  self->indices.erase(search);
+  self->freeEntries.append(i);
+  self->dirty.insert(i);
+}
+
+void ActionIndex::invalidate() {
+  if (self == nullptr)
+    return;
+  for (auto it = self->indices.constBegin(); it != self->indices.constEnd();
+       ++it)
+    self->dirty.insert(it.value());
+}
+
+void ActionIndex::add(QAction *action) {
+  auto search = indices.constFind(action);
+  if (search != indices.constEnd()) {
+    // an action made at the address of one whose destruction went unseen
+    entries[search.value()].action = action;
+    dirty.insert(search.value());
+    return;
+  }
+  int i;
+  if (!freeEntries.isEmpty()) {
+    i = freeEntries.takeLast();
+  } else {
+    i = fuzzy.append(QString());
+    entries.append(Entry());
+  }
+  entries[i] = {action, nullptr, QString()};
+  indices.insert(action, i);
+  dirty.insert(i);
+}
+
+// A menu changing moves the paths of everything in it
+void ActionIndex::markDirty(QAction *action, int depth) {
+  add(action);
+  QMenu *menu = action->menu();
+  if (menu == nullptr || depth == maxMenuDepth)
+    return;
+  for (QAction *child : menu->actions())
+    markDirty(child, depth + 1);
+}
+
+void ActionIndex::actionEvent(QActionEvent *ev) {
+  markDirty(ev->action());
+}
+
+void ActionIndex::refresh() {
+  if (dirty.isEmpty())
+    return;
+  for (int i : dirty) {
+    Entry &entry = entries[i];
+    QWidget *window = nullptr;
+    entry.text = entry.action ? describe(entry.action, &window) : QString();
+    entry.window = window;
+    fuzzy.replace(i, entry.text);
+  }
+  logDebug << "Refreshed" << dirty.size() << "of" << size() << "actions";
+  dirty.clear();
+}
+
+// The index keeps the survivors of each prefix of the last query, so typing
+// only matches the survivors of the previous key. Matches ending earliest in
+// their text come first, then the shortest texts.
+QVector<int> ActionIndex::search(const QString &query, QWidget *window, int n) {
+  refresh();
+  QString folded = query.toCaseFolded();
+  while (!folded.startsWith(fuzzy.query()))
+    fuzzy.pop();
+  for (int i = fuzzy.query().length(); i < folded.length(); ++i)
+    fuzzy.push(folded.at(i));
+
+  const QVector<int> &survivors = fuzzy.survivors();
+  const QVector<int> &positions = fuzzy.positions();
+  std::vector<std::tuple<int, int, int>> ranked;
+  for (int j = 0; j != survivors.length(); ++j) {
+    const Entry &entry = entries.at(survivors.at(j));
+    if (entry.text.isEmpty() || !entry.action || !entry.action->isEnabled())
+      continue;
+    if (window != nullptr && entry.window != window)
+      continue;
+    ranked.emplace_back(positions.at(j), entry.text.length(), survivors.at(j));
+  }
+  size_t kept = std::min(ranked.size(), static_cast<size_t>(n));
+  std::partial_sort(ranked.begin(), ranked.begin() + kept, ranked.end());
+  QVector<int> ret;
+  ret.reserve(kept);
+  for (size_t k = 0; k != kept; ++k)
+    ret.append(std::get<2>(ranked[k]));
+  return ret;
+}
+
+Palette::Palette(QWidget *parent) : QLabel(parent) {
+  setObjectName("palette");
+  setStyleSheet(promptStylesheet);
+  setTextFormat(Qt::RichText);
+  hide();
+}
+
+void Palette::setQuery(const QString &query) {
+  p_results = ActionIndex::instance()->search(query, window(), maxResults);
+  selected = 0;
+  showResults();
+}
+
+void Palette::moveSelection(int delta) {
+  if (p_results.isEmpty())
+    return;
+  selected = (selected + delta + p_results.length()) % p_results.length();
+  showResults();
+}
+
+QAction *Palette::selectedAction() const {
+  if (p_results.isEmpty())
+    return nullptr;
+  return ActionIndex::instance()->action(p_results.at(selected));
+}
+
+// The best match is at the bottom, next to the command line
+void Palette::showResults() {
+  QStringList lines;
+  for (int k = 0; k != p_results.length(); ++k) {
+    QString line =
+        ActionIndex::instance()->text(p_results.at(k)).toHtmlEscaped();
+    if (k == selected)
+      line = QStringLiteral("<b>") + line + QStringLiteral("</b>");
+    lines.prepend(line);
+  }
+  setText(lines.join(QStringLiteral("<br>")));
+  setVisible(!p_results.isEmpty());
+}
+
+} // namespace Tetradactyl
@@ -0,0 +1,98 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QAction>
+#include <QActionEvent>
+#include <QHash>
+#include <QLabel>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include "fuzzy.h"
+
+namespace Tetradactyl {
+
+// Every QAction of the application, searchable by the titles of the menus
+// leading to it, its text and its shortcut. Actions enter the index as they're
+// created or added to widgets and leave it as they're destroyed. Only the
+// texts of actions changed since are made again before a search, so opening
+// the palette never rebuilds the index.
+class ActionIndex : public QObject {
+  Q_OBJECT
+public:
+  ActionIndex(ActionIndex &) = delete;
+  ActionIndex &operator=(ActionIndex &) = delete;
+  virtual ~ActionIndex() {}
+
+  static ActionIndex *instance();
+  // called for every destroyed QObject, so it must be cheap
+  static void forget(QObject *obj);
+  // describe every action again at the next search, after action events went
+  // unseen
+  static void invalidate();
+
+  void add(QAction *action);
+  void actionEvent(QActionEvent *ev);
+  // bring the texts of the actions changed since up to date
+  void refresh();
+  // Indices of the best matches of the query among the enabled actions of the
+  // window, best first
+  QVector<int> search(const QString &query, QWidget *window, int n);
+  QAction *action(int i) const;
+  const QString &text(int i) const;
+  int size() const;
+
+private:
+  ActionIndex();
+  void markDirty(QAction *action, int depth = 0);
+
+  struct Entry {
+    QPointer<QAction> action;
+    // the window the action is shown in, possibly through menus
+    QPointer<QWidget> window;
+    QString text;
+  };
+  QVector<Entry> entries;
+  QHash<QObject *, int> indices;
+  // entries of destroyed actions, to be reused
+  QVector<int> freeEntries;
+  QSet<int> dirty;
+  FuzzyIndex fuzzy;
+
+  static ActionIndex *self;
+};
+
+inline QAction *ActionIndex::action(int i) const {
+  return entries.at(i).action;
+}
+inline const QString &ActionIndex::text(int i) const {
+  return entries.at(i).text;
+}
+inline int ActionIndex::size() const { return indices.size(); }
+
+// The best matches of the query of the command line among the actions of its
+// window, one per line. The selected one is triggered directly, without
+// opening the menus leading to it.
+class Palette : public QLabel {
+  Q_OBJECT
+public:
+  Palette(QWidget *parent);
+  virtual ~Palette() {}
+
+  void setQuery(const QString &query);
+  void moveSelection(int delta);
+  QAction *selectedAction() const;
+  const QVector<int> &results() const;
+
+private:
+  void showResults();
+
+  QVector<int> p_results;
+  int selected = 0;
+};
+
+inline const QVector<int> &Palette::results() const { return p_results; }
+
+} // namespace Tetradactyl
@@ -0,0 +1,161 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QFontMetrics>
+#include <QGuiApplication>
+#include <QLoggingCategory>
+#include <QPixmap>
+#include <QString>
+
+#include <cstring>
+
+#include "controller.h"
+#include "hint.h"
+#include "logging.h"
+#include "pixmapcache.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.pixmapcache", Qt::yellow);
+
+namespace Tetradactyl {
+
+// how many hint strings are rendered per tick of the warming timer
+static const int warmChunkSize = 16;
+
+bool operator==(const HintPixmapKey &a, const HintPixmapKey &b) {
+  return a.state == b.state && a.devicePixelRatio == b.devicePixelRatio &&
+         a.text == b.text && a.font == b.font;
+}
+
+HashValue qHash(const HintPixmapKey &key, HashValue seed) {
+  return qHash(key.text, seed) ^ (qHash(key.font, seed) << 1) ^
+         (qHash(key.devicePixelRatio, seed) << 2) ^
+         static_cast<HashValue>(key.state);
+}
+
+HintPixmapCache::HintPixmapCache() {
+  setMaxCostKb(Controller::settings.hintPixmapCacheKb);
+  warmTimer.setInterval(0);
+  connect(&warmTimer, &QTimer::timeout, this, &HintPixmapCache::warmStep);
+}
+
+HintPixmapCache::~HintPixmapCache() {
+  for (auto tmpl : templates)
+    delete tmpl;
+}
+
+HintPixmapCache *HintPixmapCache::instance() {
+  static HintPixmapCache *self = new HintPixmapCache;
+  return self;
+}
+
+void HintPixmapCache::setMaxCostKb(int kb) { cache.setMaxCost(kb); }
+
+int HintPixmapCache::costKb() const { return cache.totalCost(); }
+
+void HintPixmapCache::clear() {
+  warmTimer.stop();
+  warmQueue.clear();
+  cache.clear();
+  fonts.clear();
+  for (auto &tmpl : templates) {
+    delete tmpl;
+    tmpl = nullptr;
+  }
+}
+
+// Offscreen HintLabel styled by the application stylesheet in the given state.
+// It is never shown and serves only to render pixmaps.
+HintLabel *HintPixmapCache::templateLabel(HintState state) {
+  HintLabel *&tmpl = templates[static_cast<int>(state)];
+  if (tmpl == nullptr) {
+    tmpl = new HintLabel(state);
+    tmpl->ensurePolished();
+  }
+  return tmpl;
+}
+
+HintPixmapCache::FontInfo &HintPixmapCache::fontInfo(const QFont &font) {
+  auto search = fonts.find(font);
+  if (search != fonts.end())
+    return search.value();
+
+  FontInfo info;
+  QFontMetrics metrics(font);
+  info.height = metrics.height();
+  HintLabel *tmpl = templateLabel(HintState::Normal);
+  tmpl->setFont(font);
+  tmpl->setText(QStringLiteral("X"));
+  info.chrome = tmpl->QLabel::sizeHint() -
+                QSize(metrics.horizontalAdvance(QLatin1Char('X')), info.height);
+  return fonts.insert(font, info).value();
+}
+
+QSize HintPixmapCache::size(const QString &text, const QFont &font) {
+  FontInfo &info = fontInfo(font);
+  int width = 0;
+  for (QChar ch : text) {
+    auto search = info.advances.find(ch.unicode());
+    if (search == info.advances.end())
+      search = info.advances.insert(ch.unicode(),
+                                    QFontMetrics(font).horizontalAdvance(ch));
+    width += search.value();
+  }
+  return QSize(width, info.height) + info.chrome;
+}
+
+QPixmap HintPixmapCache::pixmap(const QString &text, HintState state,
+                                const QFont &font, qreal devicePixelRatio) {
+  HintPixmapKey key{text, state, font, devicePixelRatio};
+  if (QPixmap *cached = cache.object(key))
+    return *cached;
+
+  QPixmap *rendered = new QPixmap(render(key));
+  QPixmap ret = *rendered;
+  int costKb = qMax(1, rendered->width() * rendered->height() *
+                           rendered->depth() / 8 / 1024);
+  // QCache deletes the pixmap if it alone would exceed the memory cap
+  cache.insert(key, rendered, costKb);
+  return ret;
+}
+
+QPixmap HintPixmapCache::render(const HintPixmapKey &key) {
+  QSize logicalSize = size(key.text, key.font);
+  HintLabel *tmpl = templateLabel(key.state);
+  tmpl->setFont(key.font);
+  tmpl->setText(key.text);
+  tmpl->resize(logicalSize);
+
+  QPixmap pixmap(logicalSize * key.devicePixelRatio);
+  pixmap.setDevicePixelRatio(key.devicePixelRatio);
+  pixmap.fill(Qt::transparent);
+  tmpl->render(&pixmap);
+  return pixmap;
+}
+
+// Queue every hint string of length 1 and 2 for rendering at idle. Longer
+// strings are rare enough to be rendered on demand.
+void HintPixmapCache::warm(const char *hintChars) {
+  size_t numChars = strlen(hintChars);
+  warmQueue.clear();
+  for (size_t i = 0; i != numChars; ++i) {
+    QString first = QChar(QLatin1Char(hintChars[i]));
+    warmQueue.append(first);
+    for (size_t j = 0; j != numChars; ++j)
+      warmQueue.append(first + QLatin1Char(hintChars[j]));
+  }
+  logDebug << "Warming hint pixmap cache with" << warmQueue.length()
+           << "strings";
+  warmTimer.start();
+}
+
+void HintPixmapCache::warmStep() {
+  QFont font = templateLabel(HintState::Normal)->font();
+  qreal devicePixelRatio = qApp->devicePixelRatio();
+  for (int i = 0; i != warmChunkSize && !warmQueue.isEmpty(); ++i) {
+    QString text = warmQueue.takeLast();
+    pixmap(text, HintState::Normal, font, devicePixelRatio);
+    pixmap(text, HintState::Selected, font, devicePixelRatio);
+  }
+  if (warmQueue.isEmpty())
+    warmTimer.stop();
+}
+
+} // namespace Tetradactyl
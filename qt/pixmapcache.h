@@ -0,0 +1,81 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QCache>
+#include <QFont>
+#include <QHash>
+#include <QObject>
+#include <QPixmap>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+namespace Tetradactyl {
+
+class HintLabel;
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+using HashValue = size_t;
+#else
+using HashValue = uint;
+#endif
+
+enum class HintState { Normal, Selected, Accepted };
+
+struct HintPixmapKey {
+  QString text;
+  HintState state;
+  QFont font;
+  qreal devicePixelRatio;
+};
+
+bool operator==(const HintPixmapKey &a, const HintPixmapKey &b);
+HashValue qHash(const HintPixmapKey &key, HashValue seed = 0);
+
+// Process-wide cache of rendered hint labels. For a given hintChars there are
+// only a few hundred distinct hint strings, so each is rendered once per
+// (state, font, devicePixelRatio) and the pixmap shared between all overlays of
+// all windows. Eviction is LRU, bounded by ControllerSettings::hintPixmapCacheKb.
+class HintPixmapCache : public QObject {
+  Q_OBJECT
+public:
+  HintPixmapCache(HintPixmapCache &) = delete;
+  HintPixmapCache &operator=(HintPixmapCache &) = delete;
+  virtual ~HintPixmapCache();
+
+  static HintPixmapCache *instance();
+
+  QPixmap pixmap(const QString &text, HintState state, const QFont &font,
+                 qreal devicePixelRatio);
+  // Logical size of the rendered hint, from cached font metrics only.
+  QSize size(const QString &text, const QFont &font);
+
+  void warm(const char *hintChars);
+  void setMaxCostKb(int kb);
+  int costKb() const;
+  void clear();
+
+private:
+  HintPixmapCache();
+
+  struct FontInfo {
+    int height = 0;
+    // space taken by the stylesheet (padding, border) around the text
+    QSize chrome;
+    QHash<ushort, int> advances;
+  };
+
+  FontInfo &fontInfo(const QFont &font);
+  HintLabel *templateLabel(HintState state);
+  QPixmap render(const HintPixmapKey &key);
+  void warmStep();
+
+  QCache<HintPixmapKey, QPixmap> cache;
+  QHash<QFont, FontInfo> fonts;
+  HintLabel *templates[3] = {nullptr, nullptr, nullptr};
+
+  QTimer warmTimer;
+  QStringList warmQueue;
+};
+
+} // namespace Tetradactyl
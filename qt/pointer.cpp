@@ -0,0 +1,76 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QApplication>
+#include <QContextMenuEvent>
+#include <QLoggingCategory>
+#include <QMouseEvent>
+#include <QPointer>
+#include <QWheelEvent>
+
+#include "logging.h"
+#include "pointer.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.pointer", Qt::yellow);
+
+namespace Tetradactyl {
+
+// moves sent in between the press and release of a drag
+static const int dragSteps = 8;
+
+static QWidget *receiverAt(QWidget *host, QPoint pos) {
+  QWidget *child = host->childAt(pos);
+  return child != nullptr ? child : host;
+}
+
+// The receiver keeps the events after the press, like the implicit grab of
+// the window system
+static void sendMouse(QWidget *receiver, QWidget *host, QEvent::Type type,
+                      QPoint pos, Qt::MouseButton button,
+                      Qt::MouseButtons buttons) {
+  QPoint globalPos = host->mapToGlobal(pos);
+  QMouseEvent ev(type, receiver->mapFromGlobal(globalPos), globalPos, button,
+                 buttons, QApplication::keyboardModifiers());
+  QApplication::sendEvent(receiver, &ev);
+}
+
+void sendClick(QWidget *host, QPoint pos, Qt::MouseButton button) {
+  QPointer<QWidget> receiver = receiverAt(host, pos);
+  logInfo << "Clicking" << receiver << "at" << pos << "with" << button;
+  sendMouse(receiver, host, QEvent::MouseButtonPress, pos, button, button);
+  if (!receiver)
+    return;
+  sendMouse(receiver, host, QEvent::MouseButtonRelease, pos, button,
+            Qt::NoButton);
+  if (!receiver || button != Qt::RightButton)
+    return;
+  QPoint globalPos = host->mapToGlobal(pos);
+  QContextMenuEvent ev(QContextMenuEvent::Mouse,
+                       receiver->mapFromGlobal(globalPos), globalPos);
+  QApplication::sendEvent(receiver, &ev);
+}
+
+// Unaccepted wheel events propagate to the parents, up to a scroll area
+void sendScroll(QWidget *host, QPoint pos, int delta) {
+  QWidget *receiver = receiverAt(host, pos);
+  logInfo << "Scrolling" << receiver << "at" << pos << "by" << delta;
+  QPoint globalPos = host->mapToGlobal(pos);
+  QWheelEvent ev(receiver->mapFromGlobal(globalPos), globalPos, QPoint(),
+                 QPoint(0, delta), Qt::NoButton,
+                 QApplication::keyboardModifiers(), Qt::NoScrollPhase, false);
+  QApplication::sendEvent(receiver, &ev);
+}
+
+void sendDrag(QWidget *host, QPoint from, QPoint to) {
+  QPointer<QWidget> receiver = receiverAt(host, from);
+  logInfo << "Dragging" << receiver << "from" << from << "to" << to;
+  sendMouse(receiver, host, QEvent::MouseButtonPress, from, Qt::LeftButton,
+            Qt::LeftButton);
+  for (int i = 1; i <= dragSteps && receiver; ++i)
+    sendMouse(receiver, host, QEvent::MouseMove,
+              from + (to - from) * i / dragSteps, Qt::NoButton,
+              Qt::LeftButton);
+  if (receiver)
+    sendMouse(receiver, host, QEvent::MouseButtonRelease, to, Qt::LeftButton,
+              Qt::NoButton);
+}
+
+} // namespace Tetradactyl
@@ -0,0 +1,17 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+
+#include <QPoint>
+#include <QWidget>
+
+namespace Tetradactyl {
+
+// Mouse input synthesized at a point of a host widget, for Pointer mode. The
+// events go to the deepest child under the point, as if the window system had
+// sent them, and so reach widgets which offer no hints, like canvases.
+void sendClick(QWidget *host, QPoint pos,
+               Qt::MouseButton button = Qt::LeftButton);
+void sendScroll(QWidget *host, QPoint pos, int delta);
+void sendDrag(QWidget *host, QPoint from, QPoint to);
+
+} // namespace Tetradactyl
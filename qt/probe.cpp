@@ -1,4 +1,5 @@
 // Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QAction>
 #include <QApplication>
 #include <QDebug>
 #include <QList>
@@ -26,6 +27,8 @@
 #include "common.h"
 #include "controller.h"
 #include "logging.h"
+#include "objectpath.h"
+#include "palette.h"
 #include "probe.h"
 #include "version.h"
 
@@ -132,6 +135,8 @@ void ObjectProbe::removeQObjectCallback(QObject *obj) {
     if (index >= 0)
       self->objectsBeingCreated.removeAt(index);
   }
+  ObjectPathCache::forget(obj);
+  ActionIndex::forget(obj);
   if (nextRemoveQObjectCallback) {
     nextRemoveQObjectCallback(obj);
   }
@@ -166,6 +171,8 @@ bool ObjectProbe::interestedObject(QObject *obj) {
 
 void ObjectProbe::processCreatedObjects() {
   Q_ASSERT(QThread::currentThread() == self->thread());
+  // indexed outside of the lock, since the index may be created meanwhile
+  QList<QAction *> createdActions;
   {
     logDebug << "Processing created objects";
     TetraMutexLocker locker(&mutex);
@@ -179,9 +186,14 @@ void ObjectProbe::processCreatedObjects() {
                 obj->metaObject()->className(), (void *)obj);
         emit objectCreated(obj, QPrivateSignal());
       }
+      QAction *action = qobject_cast<QAction *>(obj);
+      if (action != nullptr)
+        createdActions.append(action);
     }
     objectsBeingCreated.clear();
   }
+  for (QAction *action : createdActions)
+    ActionIndex::instance()->add(action);
 }
 
 inline ObjectProbe *ObjectProbe::instance() { return self; }
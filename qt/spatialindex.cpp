@@ -0,0 +1,127 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QPoint>
+#include <QRect>
+
+#include <algorithm>
+#include <limits>
+
+#include "hint.h"
+#include "spatialindex.h"
+
+namespace Tetradactyl {
+
+static const qint64 unreachable = std::numeric_limits<qint64>::max();
+
+// Distance of value from the interval [low, high]
+static qint64 distanceTo(int value, int low, int high) {
+  if (value < low)
+    return qint64(low) - value;
+  if (value > high)
+    return qint64(value) - high;
+  return 0;
+}
+
+// Lower bound of the cost of the points within bounds, or unreachable if none
+// lies on the side of the direction
+static qint64 boundCost(const QRect &bounds, QPoint origin,
+                        Direction direction) {
+  qint64 along, across;
+  switch (direction) {
+  case Direction::Left:
+    if (bounds.left() >= origin.x())
+      return unreachable;
+    along = qMax<qint64>(0, qint64(origin.x()) - bounds.right());
+    across = distanceTo(origin.y(), bounds.top(), bounds.bottom());
+    break;
+  case Direction::Right:
+    if (bounds.right() <= origin.x())
+      return unreachable;
+    along = qMax<qint64>(0, qint64(bounds.left()) - origin.x());
+    across = distanceTo(origin.y(), bounds.top(), bounds.bottom());
+    break;
+  case Direction::Up:
+    if (bounds.top() >= origin.y())
+      return unreachable;
+    along = qMax<qint64>(0, qint64(origin.y()) - bounds.bottom());
+    across = distanceTo(origin.x(), bounds.left(), bounds.right());
+    break;
+  case Direction::Down:
+  default:
+    if (bounds.bottom() <= origin.y())
+      return unreachable;
+    along = qMax<qint64>(0, qint64(bounds.top()) - origin.y());
+    across = distanceTo(origin.x(), bounds.left(), bounds.right());
+    break;
+  }
+  return along + 2 * across;
+}
+
+void SpatialIndex::build(const QList<HintLabel *> &hints) {
+  nodes.clear();
+  nodes.reserve(hints.length());
+  for (HintLabel *hint : hints) {
+    QPoint point = hint->positionInOverlay();
+    nodes.push_back(Node{point, hint, QRect(point, point)});
+  }
+  build(0, nodes.size(), true);
+}
+
+void SpatialIndex::clear() { nodes.clear(); }
+
+// The median of [begin, end) in the split coordinate is the root of the
+// subtree, with the lesser points before it and the greater after it
+void SpatialIndex::build(int begin, int end, bool splitX) {
+  if (begin >= end)
+    return;
+  int mid = begin + (end - begin) / 2;
+  std::nth_element(nodes.begin() + begin, nodes.begin() + mid,
+                   nodes.begin() + end,
+                   [splitX](const Node &a, const Node &b) {
+                     return splitX ? a.point.x() < b.point.x()
+                                   : a.point.y() < b.point.y();
+                   });
+  build(begin, mid, !splitX);
+  build(mid + 1, end, !splitX);
+  QRect bounds(nodes[mid].point, nodes[mid].point);
+  if (begin < mid)
+    bounds |= nodes[begin + (mid - begin) / 2].bounds;
+  if (mid + 1 < end)
+    bounds |= nodes[mid + 1 + (end - mid - 1) / 2].bounds;
+  nodes[mid].bounds = bounds;
+}
+
+HintLabel *SpatialIndex::nearest(QPoint origin, Direction direction) const {
+  qint64 bestCost = unreachable;
+  int best = -1;
+  search(0, nodes.size(), true, origin, direction, bestCost, best);
+  return best >= 0 ? nodes[best].hint : nullptr;
+}
+
+void SpatialIndex::search(int begin, int end, bool splitX, QPoint origin,
+                          Direction direction, qint64 &bestCost,
+                          int &best) const {
+  if (begin >= end)
+    return;
+  int mid = begin + (end - begin) / 2;
+  const Node &node = nodes[mid];
+  if (boundCost(node.bounds, origin, direction) >= bestCost)
+    return;
+  QRect point(node.point, node.point);
+  qint64 cost = boundCost(point, origin, direction);
+  if (cost < bestCost && !node.hint->isHidden()) {
+    bestCost = cost;
+    best = mid;
+  }
+  // the half on the side of the origin first, as it likely holds the best
+  bool lowerFirst = splitX ? origin.x() < node.point.x()
+                           : origin.y() < node.point.y();
+  if (lowerFirst) {
+    search(begin, mid, !splitX, origin, direction, bestCost, best);
+    search(mid + 1, end, !splitX, origin, direction, bestCost, best);
+  } else {
+    search(mid + 1, end, !splitX, origin, direction, bestCost, best);
+    search(begin, mid, !splitX, origin, direction, bestCost, best);
+  }
+}
+
+} // namespace Tetradactyl
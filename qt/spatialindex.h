@@ -0,0 +1,47 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+
+#include <QList>
+#include <QPoint>
+#include <QRect>
+
+#include <vector>
+
+namespace Tetradactyl {
+
+class HintLabel;
+
+enum class Direction { Left, Down, Up, Right };
+
+// 2-d tree over the positions of the hints of an overlay, for moving the
+// selection to the nearest hint in a direction. Candidates lie strictly on
+// that side of the origin and cost the distance along the direction plus twice
+// the distance across it, so that hints in line are preferred. Subtrees whose
+// bounds can't beat the best candidate so far are skipped, which makes a move
+// O(log n) for hints laid out in rows and columns.
+class SpatialIndex {
+public:
+  void build(const QList<HintLabel *> &hints);
+  void clear();
+  bool isEmpty() const;
+
+  HintLabel *nearest(QPoint origin, Direction direction) const;
+
+private:
+  struct Node {
+    QPoint point;
+    HintLabel *hint;
+    // bounds of the points of the subtree rooted here
+    QRect bounds;
+  };
+
+  void build(int begin, int end, bool splitX);
+  void search(int begin, int end, bool splitX, QPoint origin,
+              Direction direction, qint64 &bestCost, int &best) const;
+
+  std::vector<Node> nodes;
+};
+
+inline bool SpatialIndex::isEmpty() const { return nodes.empty(); }
+
+} // namespace Tetradactyl
@@ -0,0 +1,181 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QWidget>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "action.h"
+#include "controller.h"
+#include "logging.h"
+#include "usage.h"
+
+LOGGING_CATEGORY_COLOR("tetradactyl.usage", Qt::cyan);
+
+namespace Tetradactyl {
+
+// counts halve after this many days
+static const double halfLifeDays = 14.0;
+// accepts are written out in batches
+static const int saveDelayMs = 5000;
+
+QString usageKey(QWidgetActionProxy *proxy) { return proxy->objectPath(); }
+
+UsageTable::UsageTable() {
+  saveTimer.setSingleShot(true);
+  saveTimer.setInterval(saveDelayMs);
+  connect(&saveTimer, &QTimer::timeout, this, &UsageTable::save);
+  connect(qApp, &QCoreApplication::aboutToQuit, this, [this] {
+    if (saveTimer.isActive())
+      save();
+  });
+}
+
+UsageTable::~UsageTable() {
+  if (loader != nullptr)
+    loader->wait();
+  if (saveTimer.isActive())
+    save();
+}
+
+UsageTable *UsageTable::instance() {
+  static UsageTable *self = new UsageTable;
+  return self;
+}
+
+QString UsageTable::path() const {
+  QString dir = QStandardPaths::writableLocation(
+      QStandardPaths::GenericDataLocation);
+  return dir + QStringLiteral("/tetradactyl/usage/") +
+         QCoreApplication::applicationName() + QStringLiteral(".tsv");
+}
+
+// Read and parse the table off the GUI thread. Counts recorded in the
+// meantime are merged with the loaded ones.
+void UsageTable::load() {
+  if (loaded || loader != nullptr)
+    return;
+  QString tablePath = path();
+  loader = QThread::create([this, tablePath] {
+    Counts loadedCounts = read(tablePath);
+    QMetaObject::invokeMethod(
+        this, [this, loadedCounts] { merge(loadedCounts); },
+        Qt::QueuedConnection);
+  });
+  connect(loader, &QThread::finished, loader, &QObject::deleteLater);
+  connect(loader, &QThread::finished, this, [this] { loader = nullptr; });
+  loader->start(QThread::LowPriority);
+}
+
+// The first line holds the time of saving, the rest "count\tkey". Counts are
+// decayed by the time elapsed since.
+UsageTable::Counts UsageTable::read(const QString &path) {
+  Counts ret;
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    return ret;
+  QTextStream stream(&file);
+  qint64 savedMs = stream.readLine().toLongLong();
+  double days = (QDateTime::currentMSecsSinceEpoch() - savedMs) / 86400000.0;
+  double decay = std::pow(0.5, qMax(0.0, days) / halfLifeDays);
+  while (!stream.atEnd()) {
+    QString line = stream.readLine();
+    int tab = line.indexOf(QLatin1Char('\t'));
+    if (tab <= 0)
+      continue;
+    double count = line.left(tab).toDouble() * decay;
+    if (count >= 0.01)
+      ret.insert(line.mid(tab + 1), count);
+  }
+  return ret;
+}
+
+void UsageTable::merge(const Counts &loadedCounts) {
+  for (auto it = loadedCounts.begin(); it != loadedCounts.end(); ++it)
+    counts[it.key()] += it.value();
+  loaded = true;
+  prune();
+  logInfo << "Loaded" << loadedCounts.size() << "usage counts from" << path();
+}
+
+void UsageTable::save() {
+  saveTimer.stop();
+  if (!Controller::settings.usageWeightedHints)
+    return;
+  QString tablePath = path();
+  QDir().mkpath(QFileInfo(tablePath).absolutePath());
+  QSaveFile file(tablePath);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    logWarning << "Can't write usage table" << tablePath;
+    return;
+  }
+  QTextStream stream(&file);
+  stream << QDateTime::currentMSecsSinceEpoch() << '\n';
+  for (auto it = counts.begin(); it != counts.end(); ++it)
+    stream << it.value() << '\t' << it.key() << '\n';
+  stream.flush();
+  if (!file.commit())
+    logWarning << "Can't write usage table" << tablePath;
+}
+
+void UsageTable::record(QWidgetActionProxy *proxy) {
+  QString key = usageKey(proxy);
+  counts[key] += 1.0;
+  if (counts.size() > Controller::settings.usageTableSize)
+    prune(key);
+  saveTimer.start();
+}
+
+// Drop the least used entries down to 3/4 of the bound, so that pruning is
+// amortized over many accepts. Of the entries tied with the least count kept,
+// just enough are kept to make up 3/4, the recent one first.
+void UsageTable::prune(const QString &recent) {
+  int bound = Controller::settings.usageTableSize;
+  if (counts.size() <= bound)
+    return;
+  size_t keep = bound * 3 / 4;
+  if (keep == 0) {
+    counts.clear();
+    return;
+  }
+  std::vector<double> values(counts.begin(), counts.end());
+  std::nth_element(values.begin(), values.begin() + keep - 1, values.end(),
+                   std::greater<double>());
+  double threshold = values[keep - 1];
+  size_t ties = keep - std::count_if(values.begin(), values.end(),
+                                     [=](double v) { return v > threshold; });
+  auto search = counts.constFind(recent);
+  if (search != counts.constEnd() && search.value() == threshold)
+    ties--;
+  for (auto it = counts.begin(); it != counts.end();) {
+    if (it.value() == threshold && it.key() != recent) {
+      if (ties > 0) {
+        ties--;
+        ++it;
+      } else {
+        it = counts.erase(it);
+      }
+    } else if (it.value() < threshold) {
+      it = counts.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void UsageTable::clear() {
+  saveTimer.stop();
+  counts.clear();
+}
+
+} // namespace Tetradactyl
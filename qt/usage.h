@@ -0,0 +1,60 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+#pragma once
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+
+namespace Tetradactyl {
+
+class QWidgetActionProxy;
+
+// Stable identity of a hinted target across runs: its object path, which
+// tells pseudo-widgets like tabs and menu items from their widget.
+QString usageKey(QWidgetActionProxy *proxy);
+
+// Per-application counts of accepted targets, persisted in a small table in
+// the data directory. The table is loaded on a worker thread, so that the
+// first paint never waits on the disk. Counts decay with a half-life of
+// days and the least used entries are dropped beyond
+// ControllerSettings::usageTableSize.
+class UsageTable : public QObject {
+  Q_OBJECT
+public:
+  UsageTable(UsageTable &) = delete;
+  UsageTable &operator=(UsageTable &) = delete;
+  virtual ~UsageTable();
+
+  static UsageTable *instance();
+
+  void load();
+  void save();
+  void record(QWidgetActionProxy *proxy);
+  double weight(const QString &key) const;
+  int size() const;
+  bool isLoaded() const;
+  QString path() const;
+  void clear();
+
+private:
+  UsageTable();
+
+  using Counts = QHash<QString, double>;
+  static Counts read(const QString &path);
+  void merge(const Counts &loaded);
+  void prune(const QString &recent = QString());
+
+  Counts counts;
+  QThread *loader = nullptr;
+  bool loaded = false;
+  QTimer saveTimer;
+};
+
+inline int UsageTable::size() const { return counts.size(); }
+inline bool UsageTable::isLoaded() const { return loaded; }
+inline double UsageTable::weight(const QString &key) const {
+  return counts.value(key, 0.0);
+}
+
+} // namespace Tetradactyl
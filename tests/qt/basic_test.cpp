@@ -112,14 +112,12 @@ void BasicTest::acceptedHintHighlightTest() {
   QTest::keyClicks(win, "f");
   QTest::keyClicks(win, "aa");
   QCOMPARE(acceptedSpy->count(), 1);
-  QTest::qSleep(100);
-  QVERIFY2(win->findChildren<HintLabel *>().length() == 1,
-           "Accepted hint trace still visible");
-  HintLabel *acceptedHint = win->findChild<HintLabel *>();
-  QVERIFY(acceptedHint->isSelected());
-  QTest::qWait(500);
   QVERIFY2(win->findChildren<HintLabel *>().length() == 0,
-           "Hint trace deleted");
+           "Accepted hint isn't kept around as a widget");
+  QTest::qWait(100);
+  QVERIFY2(overlay->hasTracer(), "Accepted hint trace still visible");
+  QTest::qWait(500);
+  QVERIFY2(!overlay->hasTracer(), "Hint trace expired");
 }
 
 } // namespace Tetradactyl
@@ -6,7 +6,10 @@
 #include <QList>
 #include <QMainWindow>
 #include <QPushButton>
+#include <QScopeGuard>
+#include <QShortcut>
 #include <QSignalSpy>
+#include <QTabBar>
 #include <QVBoxLayout>
 #include <QWindow>
 #include <QtTest>
@@ -22,15 +25,22 @@
 #include <qwidget.h>
 
 #include "common.h"
+#include <qt/action.h>
+#include <qt/commandline.h>
 #include <qt/controller.h>
 #include <qt/hint.h>
 #include <qt/logging.h>
+#include <qt/marks.h>
 #include <qt/overlay.h>
+#include <qt/pixmapcache.h>
+#include <qt/usage.h>
 
 #define NUM_BUTTONS 10
 #define NUM_LINEEDITS 2
 #define NUM_LABELS 2
+#define NUM_FILTERED_BUTTONS 3000
 
+using Tetradactyl::CommandLine;
 using Tetradactyl::Controller;
 using Tetradactyl::HintLabel;
 using Tetradactyl::Overlay;
@@ -46,10 +56,31 @@ private slots:
   void testHintCancel();
   void testHintVisibilityAfterPushPopKey();
   void testHintNextHint();
+  void testHintNextHintReadingOrder();
   void testControllersAndOverlayCreation();
   void testHintFocusInput();
   void testHintYank();
   void testHintFocus();
+  void testHintPixmapCache();
+  void testRelayoutAfterResize();
+  void testFilteredHints();
+  void benchmarkTextFilter_data();
+  void benchmarkTextFilter();
+  void testPrefixFreeHintCodes();
+  void testUsageWeightedHintCodes();
+  void testControllerLookupAfterReparent();
+  void testKeymapCountsAndSequences();
+  void testNavigateHints();
+  void testHintPages();
+  void testPointerClick();
+  void testPointerGridShape();
+  void testRepeatLastAccept();
+  void testRepeatCommand();
+  void testMarks();
+  void testMacro();
+  void testReplayCommand();
+  void testContinuousHints();
+  void testContinuousHintPages();
 
 private:
   QWidget *win;
@@ -85,6 +116,7 @@ void BasicControllerTest::init() {
     labels.append(label);
     layout->addWidget(label);
   }
+  Tetradactyl::useFixedLengthHintCodes();
   Controller::createController();
   controller = Controller::instance();
   windowController = controller->windows().at(0);
@@ -222,6 +254,30 @@ void BasicControllerTest::testHintNextHint() {
            "shift+tab wraps backward to the last visible hint");
 }
 
+// Tab goes top to bottom even when the codes don't, here in discovery order
+void BasicControllerTest::testHintNextHintReadingOrder() {
+  layout->removeWidget(buttons.at(9));
+  layout->insertWidget(0, buttons.at(9));
+  layout->activate();
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(overlay->selectedHint()->target, buttons.at(0));
+  QCOMPARE(overlay->visibleHints().at(0)->target, buttons.at(9));
+  QTest::keyClick(win, Qt::Key_Tab);
+  QCOMPARE(overlay->selectedHint()->target, buttons.at(1));
+  QTest::keyClick(win, Qt::Key_Backtab);
+  QTest::keyClick(win, Qt::Key_Backtab);
+  QCOMPARE(overlay->selectedHint()->target, buttons.at(9));
+  QTest::keyClick(win, Qt::Key_Backtab);
+  QCOMPARE(overlay->selectedHint()->target, buttons.at(NUM_BUTTONS - 2));
+
+  // after filtering to the "S" hints of buttons 7-9, button 9 comes first
+  QTest::keyClick(win, Qt::Key_S);
+  QCOMPARE(overlay->visibleHints().length(), 3);
+  QCOMPARE(overlay->visibleHints().at(0)->target, buttons.at(9));
+  QTest::keyClick(win, Qt::Key_Tab);
+  QCOMPARE(overlay->selectedHint()->target, buttons.at(9));
+}
+
 void BasicControllerTest::testHintFocusInput() {
   QTest::keyClick(win, Qt::Key_G);
   QTest::keyClick(win, Qt::Key_I);
@@ -274,5 +330,544 @@ void BasicControllerTest::testHintFocus() {
            "Accepted widget for HintMode::Focusable has focus set");
 }
 
+void BasicControllerTest::testHintPixmapCache() {
+  using Tetradactyl::HintPixmapCache;
+  using Tetradactyl::HintState;
+  QTest::keyClick(win, Qt::Key_F);
+  HintLabel *label = overlay->hints().at(0);
+  HintPixmapCache *cache = HintPixmapCache::instance();
+  QCOMPARE(label->sizeHint(), cache->size(label->text(), label->font()));
+  QPixmap pixmap = cache->pixmap(label->text(), HintState::Selected,
+                                 label->font(), label->devicePixelRatioF());
+  QVERIFY2(cache->costKb() > 0, "Rendered hint pixmaps are cached");
+  QCOMPARE(pixmap.deviceIndependentSize().toSize(), label->sizeHint());
+  // same key yields the same shared pixmap
+  QPixmap again = cache->pixmap(label->text(), HintState::Selected,
+                                label->font(), label->devicePixelRatioF());
+  QCOMPARE(again.cacheKey(), pixmap.cacheKey());
+}
+
+void BasicControllerTest::testRelayoutAfterResize() {
+  QTest::keyClick(win, Qt::Key_F);
+  HintLabel *label = overlay->hints().last();
+  QPushButton *button = buttons.last();
+  // a burst of resizes is coalesced into a single relayout
+  for (int i = 1; i <= 10; ++i)
+    win->resize(win->width() + 10, win->height() + 10 * i);
+  QTRY_COMPARE(label->pos(),
+               button->mapTo(win, label->positionInTarget()));
+  QCOMPARE(label->positionInOverlay(), label->pos());
+}
+
+void BasicControllerTest::testFilteredHints() {
+  QTest::keyClick(win, Qt::Key_Slash);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QVERIFY(windowController->isFiltering());
+  // with 10 hints, codes over the 10 digits are a single character
+  QCOMPARE(overlay->visibleHints().length(), NUM_BUTTONS);
+  QCOMPARE(overlay->hints().at(0)->text(), "1");
+
+  // "Button N" matches "btn" fuzzily, but not "btx"
+  QTest::keyClicks(win, "btx");
+  QCOMPARE(overlay->visibleHints().length(), 0);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QTest::keyClick(win, Qt::Key_Backspace);
+  QTest::keyClicks(win, "n");
+  QCOMPARE(overlay->visibleHints().length(), NUM_BUTTONS);
+
+  QSignalSpy clickedSpy(buttons.at(1), &QPushButton::clicked);
+  QTest::keyClicks(win, "2");
+  QCOMPARE(clickedSpy.count(), 1);
+  QVERIFY(!windowController->isFiltering());
+}
+
+void BasicControllerTest::benchmarkTextFilter_data() {
+  QTest::addColumn<QString>("query");
+  QTest::newRow("one key") << "b";
+  QTest::newRow("several keys") << "btn 12";
+  QTest::newRow("no match") << "xqz";
+}
+
+// Typing a filter over thousands of candidates key by key, and erasing it.
+// Only the labels whose match or code changes are touched.
+void BasicControllerTest::benchmarkTextFilter() {
+  QFETCH(QString, query);
+  for (int i = 0; i != NUM_FILTERED_BUTTONS; ++i)
+    (new QPushButton(QString("Button %1").arg(i), win))->show();
+  QTest::keyClick(win, Qt::Key_Slash);
+  QVERIFY(windowController->isFiltering());
+  QVERIFY(overlay->hints().length() >= NUM_FILTERED_BUTTONS);
+  QBENCHMARK {
+    for (QChar ch : query)
+      overlay->pushTextFilter(ch);
+    for (int i = 0; i != query.length(); ++i)
+      overlay->popTextFilter();
+  }
+  QCOMPARE(overlay->visibleHints().length(), overlay->hints().length());
+}
+
+void BasicControllerTest::testPrefixFreeHintCodes() {
+  using Tetradactyl::HintGenerator;
+  HintGenerator codes;
+  codes.generate("ASDFJKL", 8, Tetradactyl::PrefixFreeCodes);
+  QStringList generated;
+  for (int i = 0; i != codes.size(); ++i)
+    generated.append(codes[i]);
+  QCOMPARE(generated,
+           QStringList({"A", "S", "D", "F", "J", "K", "LA", "LS"}));
+
+  // once sorted, a code that is a prefix of another precedes it directly
+  for (int n = 1; n <= 400; ++n) {
+    codes.generate("ASDFJKL", n, Tetradactyl::PrefixFreeCodes);
+    QCOMPARE(codes.size(), n);
+    QStringList sorted;
+    for (int i = 0; i != n; ++i)
+      sorted.append(codes[i]);
+    sorted.sort();
+    for (int i = 1; i < n; ++i)
+      QVERIFY2(!sorted.at(i).startsWith(sorted.at(i - 1)),
+               qPrintable(sorted.at(i - 1) + " prefixes " + sorted.at(i)));
+  }
+
+  // the shortest codes go to the hints nearest the focus
+  Controller::settings.hintCodeStyle = Tetradactyl::PrefixFreeCodes;
+  Controller::settings.hintOrdering = Tetradactyl::FocusProximityOrder;
+  buttons.last()->setFocus();
+  QTest::keyClick(win, Qt::Key_F);
+  auto codeOf = [this](QWidget *target) {
+    for (HintLabel *hint : overlay->hints())
+      if (hint->target == target)
+        return hint->text();
+    return QString();
+  };
+  QCOMPARE(codeOf(buttons.last()), "A");
+  QCOMPARE(codeOf(buttons.first()).length(), 2);
+  // a single letter is a complete code
+  QSignalSpy clickedSpy(buttons.last(), &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(clickedSpy.count(), 1);
+}
+
+void BasicControllerTest::testUsageWeightedHintCodes() {
+  using Tetradactyl::QWidgetActionProxy;
+  using Tetradactyl::UsageTable;
+  using Tetradactyl::usageKey;
+  QWidgetActionProxy third(buttons.at(3)), fourth(buttons.at(4));
+  QVERIFY(usageKey(&third).endsWith("QPushButton[3]"));
+  QVERIFY(usageKey(&third) != usageKey(&fourth));
+  // the first tab sits at the origin of its bar, and is told from the bar
+  QTabBar bar(win);
+  bar.addTab("First");
+  Tetradactyl::QTabBarActionProxy firstTab(0, QPoint(0, 0), &bar);
+  QWidgetActionProxy wholeBar(&bar);
+  QVERIFY(usageKey(&firstTab) != usageKey(&wholeBar));
+  UsageTable *usage = UsageTable::instance();
+  usage->record(&fourth);
+  usage->record(&fourth);
+  QCOMPARE(usage->weight(usageKey(&fourth)), 2.0);
+  usage->clear();
+
+  // a full table of single accepts shrinks to 3/4, keeping the last one
+  int usageTableSize = Controller::settings.usageTableSize;
+  auto restoreSize = qScopeGuard(
+      [=] { Controller::settings.usageTableSize = usageTableSize; });
+  Controller::settings.usageTableSize = 8;
+  QList<QWidgetActionProxy *> proxies;
+  for (int i = 0; i != 9; ++i)
+    proxies.append(new QWidgetActionProxy(buttons.at(i)));
+  auto deleteProxies = qScopeGuard([&] { qDeleteAll(proxies); });
+  for (int i = 0; i != 8; ++i)
+    usage->record(proxies.at(i));
+  QCOMPARE(usage->size(), 8);
+  usage->record(proxies.at(8));
+  QCOMPARE(usage->size(), 6);
+  QCOMPARE(usage->weight(usageKey(proxies.at(8))), 1.0);
+  usage->clear();
+
+  // a heavy target among many gets a single letter, the rest stay balanced
+  Tetradactyl::HintGenerator codes;
+  QVector<double> weights(30, 1.0);
+  weights[20] = 100.0;
+  codes.generate("ASDFJKL", weights);
+  QCOMPARE(codes.size(), 30);
+  QCOMPARE(QString(codes[20]).length(), 1);
+  QStringList sorted;
+  for (int i = 0; i != codes.size(); ++i) {
+    QVERIFY(QString(codes[i]).length() <= 2);
+    sorted.append(codes[i]);
+  }
+  sorted.sort();
+  for (int i = 1; i < sorted.length(); ++i)
+    QVERIFY(!sorted.at(i).startsWith(sorted.at(i - 1)));
+}
+
+void BasicControllerTest::testControllerLookupAfterReparent() {
+  Controller *instance = Controller::instance();
+  QPushButton *button = buttons.at(0);
+  QCOMPARE(instance->findControllerForWidget(button), windowController);
+  // cached by window, and invalidated when the button moves to another one
+  QWidget other;
+  button->setParent(&other);
+  QVERIFY(instance->findControllerForWidget(button) != windowController);
+  button->setParent(win);
+  QCOMPARE(instance->findControllerForWidget(button), windowController);
+}
+
+void BasicControllerTest::testKeymapCountsAndSequences() {
+  // a client shortcut on the same key doesn't take it from Tetradactyl
+  QShortcut clientShortcut(QKeySequence(Qt::Key_F), win);
+  QSignalSpy clientSpy(&clientShortcut, &QShortcut::activated);
+  QSignalSpy firstSpy(buttons.at(0), &QPushButton::clicked);
+  QSignalSpy secondSpy(buttons.at(1), &QPushButton::clicked);
+
+  // with a count of 2, hinting starts over after the first accept
+  QTest::keyClick(win, Qt::Key_2);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QTest::keyClicks(win, "AA");
+  QCOMPARE(firstSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QTest::keyClicks(win, "AS");
+  QCOMPARE(secondSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QCOMPARE(clientSpy.count(), 0);
+
+  // "gi" is given up if "i" comes after the timeout
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::qWait(Controller::settings.keySequenceTimeoutMs + 100);
+  QTest::keyClick(win, Qt::Key_I);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_I);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QCOMPARE(windowController->currentHintMode(), Tetradactyl::Editable);
+}
+
+void BasicControllerTest::testNavigateHints() {
+  QSignalSpy clickedSpy(buttons.at(1), &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_N);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QVERIFY(windowController->isNavigating());
+  QCOMPARE(overlay->selectedWidget(), buttons.at(0));
+
+  QTest::keyClicks(win, "jj");
+  QCOMPARE(overlay->selectedWidget(), buttons.at(2));
+  QTest::keyClick(win, Qt::Key_K);
+  QCOMPARE(overlay->selectedWidget(), buttons.at(1));
+  // nothing beside the buttons of the column, and codes don't count
+  QTest::keyClicks(win, "hlaa");
+  QCOMPARE(overlay->selectedWidget(), buttons.at(1));
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+
+  QTest::keyClick(win, Qt::Key_Return);
+  QCOMPARE(clickedSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QVERIFY(!windowController->isNavigating());
+}
+
+void BasicControllerTest::testHintPages() {
+  int maxHintsPerPage = Controller::settings.maxHintsPerPage;
+  auto restore = qScopeGuard(
+      [=] { Controller::settings.maxHintsPerPage = maxHintsPerPage; });
+  Controller::settings.maxHintsPerPage = 4;
+  QSignalSpy clickedSpy(buttons.at(4), &QPushButton::clicked);
+
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(windowController->currentAction()->pageCount(), 3);
+  QCOMPARE(overlay->hints().length(), 4);
+  QCOMPARE(overlay->hints().at(0)->target, buttons.at(0));
+  // paging keeps the candidates and codes stay short
+  QTest::keyClick(win, Qt::Key_Space);
+  QCOMPARE(windowController->currentAction()->currentPage(), 1);
+  QCOMPARE(overlay->hints().length(), 4);
+  QCOMPARE(overlay->hints().at(0)->target, buttons.at(4));
+  QCOMPARE(overlay->hints().at(0)->text(), "A");
+  QTest::keyClick(win, Qt::Key_Space);
+  QCOMPARE(overlay->hints().length(), 2);
+  QTest::keyClick(win, Qt::Key_Space);
+  QCOMPARE(windowController->currentAction()->currentPage(), 0);
+  QTest::keyClick(win, Qt::Key_Space);
+
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(clickedSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+}
+
+// Narrowing the grid down to the center of a button takes a number of keys
+// logarithmic in the size of the window
+void BasicControllerTest::testPointerClick() {
+  QPushButton *button = buttons.at(3);
+  QSignalSpy clickedSpy(button, &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_P);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Pointer);
+  QVERIFY(overlay->hasPointerGrid());
+  QCOMPARE(overlay->pointerCell(), win->rect());
+
+  QPoint center = button->geometry().center();
+  int keys = 0;
+  while (!button->geometry().contains(overlay->pointerCell()) && keys < 20) {
+    int i = 0;
+    while (!overlay->pointerSubcell(i).contains(center))
+      i++;
+    QTest::keyClick(win, overlay->pointerLabels().at(i).toLower().toLatin1());
+    keys++;
+  }
+  QVERIFY(keys <= 8);
+  QVERIFY(button->geometry().contains(overlay->pointerPosition()));
+  // backspace goes back a step
+  QRect cell = overlay->pointerCell();
+  QTest::keyClick(win, Qt::Key_A);
+  QTest::keyClick(win, Qt::Key_Backspace);
+  QCOMPARE(overlay->pointerCell(), cell);
+
+  QTest::keyClick(win, Qt::Key_Return);
+  QCOMPARE(clickedSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QVERIFY(!overlay->hasPointerGrid());
+}
+
+// Every key splits the cell both ways, and too few hint characters for that
+// refuse Pointer mode
+void BasicControllerTest::testPointerGridShape() {
+  const char *hintChars = Controller::settings.hintChars;
+  auto restore =
+      qScopeGuard([=] { Controller::settings.hintChars = hintChars; });
+  Controller::settings.hintChars = "ASDFJ";
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_P);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Pointer);
+  QCOMPARE(overlay->pointerSubcellCount(), 4);
+  QRect cell = overlay->pointerCell();
+  QTest::keyClick(win, Qt::Key_A);
+  QVERIFY(overlay->pointerCell().width() < cell.width());
+  QVERIFY(overlay->pointerCell().height() < cell.height());
+  QTest::keyClick(win, Qt::Key_Escape);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+
+  Controller::settings.hintChars = "ASD";
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_P);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QVERIFY(!overlay->hasPointerGrid());
+}
+
+void BasicControllerTest::testRepeatLastAccept() {
+  buttons.at(0)->setObjectName("refresh");
+  QSignalSpy clickedSpy(buttons.at(0), &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClicks(win, "aa");
+  QCOMPARE(clickedSpy.count(), 1);
+
+  // no hints are made for a repeat
+  QTest::keyClick(win, Qt::Key_Period);
+  QCOMPARE(clickedSpy.count(), 2);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QCOMPARE(overlay->hints().length(), 0);
+  QTest::keyClicks(win, "3.");
+  QCOMPARE(clickedSpy.count(), 5);
+
+  // a widget made anew is found by its path
+  delete buttons.takeFirst();
+  QPushButton *button = new QPushButton("Refresh", win);
+  button->setObjectName("refresh");
+  layout->addWidget(button);
+  button->show();
+  QSignalSpy newClickedSpy(button, &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_Period);
+  QCOMPARE(newClickedSpy.count(), 1);
+  QTest::keyClick(win, Qt::Key_Period);
+  QCOMPARE(newClickedSpy.count(), 2);
+}
+
+// Commands run once the prompt is closed, back in Normal mode
+void BasicControllerTest::testRepeatCommand() {
+  CommandLine *prompt = windowController->mainOverlay()->commandLine();
+  QSignalSpy clickedSpy(buttons.at(0), &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClicks(win, "aa");
+  QCOMPARE(clickedSpy.count(), 1);
+
+  QTest::keyClick(win, Qt::Key_Colon);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Input);
+  QTest::keyClicks(prompt, "repeat");
+  QTest::keyClick(prompt, Qt::Key_Return);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QVERIFY(!prompt->isVisible());
+  QTRY_COMPARE(clickedSpy.count(), 2);
+}
+
+void BasicControllerTest::testMarks() {
+  using Tetradactyl::MarkTable;
+  bool persistMarks = Controller::settings.persistMarks;
+  auto restore = qScopeGuard(
+      [=] { Controller::settings.persistMarks = persistMarks; });
+  Controller::settings.persistMarks = false;
+  MarkTable::instance()->clear();
+  QSignalSpy clickedSpy(buttons.at(2), &QPushButton::clicked);
+
+  // with nothing accepted yet, the focus widget is marked
+  buttons.at(5)->setFocus();
+  QTest::keyClick(win, Qt::Key_M, Qt::ShiftModifier);
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(MarkTable::instance()->size(), 1);
+  buttons.at(0)->setFocus();
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClicks(win, "ad");
+  QCOMPARE(clickedSpy.count(), 1);
+  QTest::keyClick(win, Qt::Key_M, Qt::ShiftModifier);
+  QTest::keyClick(win, Qt::Key_B);
+
+  QTest::keyClick(win, Qt::Key_Apostrophe);
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(qApp->focusWidget(), buttons.at(5));
+  QTest::keyClick(win, Qt::Key_Apostrophe);
+  QTest::keyClick(win, Qt::Key_B);
+  QCOMPARE(clickedSpy.count(), 2);
+  QCOMPARE(overlay->hints().length(), 0);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  MarkTable::instance()->clear();
+}
+
+void BasicControllerTest::testMacro() {
+  QSignalSpy firstSpy(buttons.at(0), &QPushButton::clicked);
+  QSignalSpy thirdSpy(buttons.at(2), &QPushButton::clicked);
+  QTest::keyClicks(win, "qa");
+  QVERIFY(windowController->isRecordingMacro());
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClicks(win, "aa");
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClicks(win, "ad");
+  QTest::keyClick(win, Qt::Key_Q);
+  QVERIFY(!windowController->isRecordingMacro());
+  QCOMPARE(firstSpy.count(), 1);
+  QCOMPARE(thirdSpy.count(), 1);
+
+  // replay makes no hints and takes counts
+  QTest::keyClick(win, Qt::Key_At);
+  QTest::keyClick(win, Qt::Key_A);
+  QTRY_COMPARE(thirdSpy.count(), 2);
+  QCOMPARE(firstSpy.count(), 2);
+  QCOMPARE(overlay->hints().length(), 0);
+  QTRY_VERIFY(!windowController->isReplayingMacro());
+  QTest::keyClicks(win, "3@a");
+  QTRY_COMPARE(thirdSpy.count(), 5);
+  QCOMPARE(firstSpy.count(), 5);
+  QTRY_VERIFY(!windowController->isReplayingMacro());
+
+  // text typed into an input widget, and leaving it
+  QTest::keyClicks(win, "qb");
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_I);
+  QTest::keyClick(win, Qt::Key_S);
+  QLineEdit *lineEdit = qobject_cast<QLineEdit *>(win->focusWidget());
+  QVERIFY(lineEdit != nullptr);
+  QTest::keyClicks(lineEdit, "xyz");
+  QTest::keyClick(lineEdit, Qt::Key_Escape);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QTest::keyClick(win, Qt::Key_Q);
+  lineEdit->clear();
+  QTest::keyClicks(win, "@b");
+  QTRY_COMPARE(lineEdit->text(), QString("xyz"));
+  QTRY_COMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+}
+
+void BasicControllerTest::testReplayCommand() {
+  CommandLine *prompt = windowController->mainOverlay()->commandLine();
+  QSignalSpy clickedSpy(buttons.at(2), &QPushButton::clicked);
+  QTest::keyClicks(win, "qa");
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClicks(win, "ad");
+  QTest::keyClick(win, Qt::Key_Q);
+  QCOMPARE(clickedSpy.count(), 1);
+
+  QTest::keyClick(win, Qt::Key_Colon);
+  QTest::keyClicks(prompt, "replay a 3");
+  QTest::keyClick(prompt, Qt::Key_Return);
+  QTRY_COMPARE(clickedSpy.count(), 4);
+  QTRY_VERIFY(!windowController->isReplayingMacro());
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+}
+
+void BasicControllerTest::testContinuousHints() {
+  QSignalSpy firstSpy(buttons.at(0), &QPushButton::clicked);
+  QSignalSpy secondSpy(buttons.at(1), &QPushButton::clicked);
+  QSignalSpy thirdSpy(buttons.at(2), &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_F, Qt::ShiftModifier);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QVERIFY(windowController->isContinuous());
+  QTest::keyClicks(win, "aa");
+  QCOMPARE(firstSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  // the accepted hint is gone and the rest keep their codes
+  QCOMPARE(overlay->hints().length(), NUM_BUTTONS - 1);
+  QCOMPARE(overlay->visibleHints().length(), NUM_BUTTONS - 1);
+  QTest::keyClicks(win, "ad");
+  QCOMPARE(thirdSpy.count(), 1);
+  QCOMPARE(overlay->hints().length(), NUM_BUTTONS - 2);
+  QTest::keyClicks(win, "as");
+  QCOMPARE(secondSpy.count(), 1);
+  QCOMPARE(firstSpy.count(), 1);
+
+  // a change of the UI makes hints anew
+  connect(buttons.at(3), &QPushButton::clicked, buttons.at(4),
+          &QWidget::hide);
+  QTest::keyClicks(win, "af");
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QCOMPARE(overlay->hints().length(), NUM_BUTTONS - 1);
+  QTest::keyClicks(win, "aa");
+  QCOMPARE(firstSpy.count(), 2);
+
+  QTest::keyClick(win, Qt::Key_Escape);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QVERIFY(!windowController->isContinuous());
+  QCOMPARE(overlay->hints().length(), 0);
+}
+
+// Accepted targets don't come back on their page, and an emptied page gives
+// way to the next
+void BasicControllerTest::testContinuousHintPages() {
+  int maxHintsPerPage = Controller::settings.maxHintsPerPage;
+  auto restore = qScopeGuard(
+      [=] { Controller::settings.maxHintsPerPage = maxHintsPerPage; });
+  Controller::settings.maxHintsPerPage = 4;
+  QList<QSignalSpy *> spies;
+  for (QPushButton *button : buttons)
+    spies.append(new QSignalSpy(button, &QPushButton::clicked));
+  auto deleteSpies = qScopeGuard([&] { qDeleteAll(spies); });
+
+  QTest::keyClick(win, Qt::Key_F, Qt::ShiftModifier);
+  QTest::keyClick(win, Qt::Key_A);
+  QTest::keyClick(win, Qt::Key_S);
+  QCOMPARE(spies.at(0)->count(), 1);
+  QCOMPARE(spies.at(1)->count(), 1);
+  QCOMPARE(overlay->hints().length(), 2);
+  QTest::keyClick(win, Qt::Key_Space);
+  QCOMPARE(overlay->hints().at(0)->target, buttons.at(4));
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(spies.at(4)->count(), 1);
+  QTest::keyClick(win, Qt::Key_Space);
+  QCOMPARE(overlay->hints().length(), 2);
+  QTest::keyClick(win, Qt::Key_Space);
+  QCOMPARE(windowController->currentAction()->currentPage(), 0);
+  QCOMPARE(overlay->hints().length(), 2);
+  QCOMPARE(overlay->hints().at(0)->target, buttons.at(2));
+  QCOMPARE(overlay->hints().at(1)->target, buttons.at(3));
+
+  QTest::keyClick(win, Qt::Key_A);
+  QTest::keyClick(win, Qt::Key_S);
+  QCOMPARE(spies.at(2)->count(), 1);
+  QCOMPARE(spies.at(3)->count(), 1);
+  QCOMPARE(spies.at(0)->count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QCOMPARE(windowController->currentAction()->currentPage(), 1);
+  QCOMPARE(overlay->hints().length(), 3);
+  QCOMPARE(overlay->hints().at(0)->target, buttons.at(5));
+  QTest::keyClick(win, Qt::Key_Escape);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+}
+
 QTEST_MAIN(BasicControllerTest);
 #include "basiccontroller_test.moc"
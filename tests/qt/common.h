@@ -3,6 +3,7 @@
 
 #include <QApplication>
 #include <QSignalSpy>
+#include <QStandardPaths>
 #include <QWidget>
 
 #include <qt/controller.h>
@@ -12,6 +13,15 @@
 
 namespace Tetradactyl {
 
+// Tests predating prefix-free codes expect fixed-length codes in discovery
+// order, e.g. "AA" to "SD" for 10 hints. Usage counts would also make them
+// depend on earlier runs.
+inline void useFixedLengthHintCodes() {
+  Controller::settings.hintCodeStyle = FixedLengthCodes;
+  Controller::settings.hintOrdering = DiscoveryOrder;
+  Controller::settings.usageWeightedHints = false;
+}
+
 class QtBaseTest : public QObject {
 public:
   QtBaseTest() {}
@@ -19,6 +29,7 @@ public:
 
 protected:
   void init() {
+    useFixedLengthHintCodes();
     Controller::createController();
     controller = Controller::instance();
     settings = &controller->settings;
@@ -57,3 +68,8 @@ static void __attribute__((constructor)) setupDefaultQtPlatform() {
   if (qgetenv("QT_QPA_PLATFORM") == "")
     qputenv("QT_QPA_PLATFORM", "offscreen");
 }
+
+// usage tables and marks are kept out of the data directory of the user
+static void __attribute__((constructor)) setupTestPaths() {
+  QStandardPaths::setTestModeEnabled(true);
+}
@@ -0,0 +1,203 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+
+#include <QCoreApplication>
+#include <QEvent>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QShortcut>
+#include <QSignalSpy>
+#include <QVBoxLayout>
+#include <QWidget>
+#include <QtTest>
+
+#include "common.h"
+#include <qt/controller.h>
+
+#define NUM_BUTTONS 10
+#define EVENTS_PER_ITERATION 1000
+
+using Tetradactyl::Controller;
+using Tetradactyl::WindowController;
+
+// Key presses reach the controller through filters on the windows and the
+// focus widget only. Other events pass a single application filter, which
+// returns at once for all but a few types, and is gone in Ignore mode.
+class EventFilterTest : public QObject {
+  Q_OBJECT
+private slots:
+  void init();
+  void cleanup();
+  void testKeysOfFocusWidget();
+  void testKeysOfWindow();
+  void testIgnoreMode();
+  void testIgnoreWindowClasses();
+  void testTypeAheadAfterPendingBinding();
+  void testCountGivenBack();
+  void benchmarkNonKeyEvents_data();
+  void benchmarkNonKeyEvents();
+
+private:
+  QWidget *win;
+  QLineEdit *lineEdit;
+  QList<QPushButton *> buttons;
+};
+
+void EventFilterTest::init() {
+  win = new QWidget;
+  QVBoxLayout *layout = new QVBoxLayout(win);
+  buttons.clear();
+  for (int i = 0; i != NUM_BUTTONS; ++i) {
+    QPushButton *button = new QPushButton(QString("Button %1").arg(i), win);
+    buttons.append(button);
+    layout->addWidget(button);
+  }
+  lineEdit = new QLineEdit(win);
+  layout->addWidget(lineEdit);
+  Tetradactyl::useFixedLengthHintCodes();
+  win->show();
+  QVERIFY(QTest::qWaitForWindowActive(win));
+}
+
+void EventFilterTest::cleanup() {
+  delete Controller::instance();
+  delete win;
+}
+
+void EventFilterTest::testKeysOfFocusWidget() {
+  Controller::createController();
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  buttons.at(3)->setFocus();
+  QCOMPARE(qApp->focusWidget(), buttons.at(3));
+  QTest::keyClick(buttons.at(3), Qt::Key_F);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QTest::keyClick(buttons.at(3), Qt::Key_Escape);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+
+  // typing into an input widget isn't intercepted
+  lineEdit->setFocus();
+  QTest::keyClicks(lineEdit, "xyz");
+  QCOMPARE(lineEdit->text(), "xyz");
+}
+
+void EventFilterTest::testKeysOfWindow() {
+  Controller::createController();
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  // hint keys are routed by the filter too
+  QSignalSpy clickedSpy(buttons.at(0), &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_A);
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(clickedSpy.count(), 1);
+}
+
+void EventFilterTest::testIgnoreMode() {
+  Controller::createController();
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  QShortcut clientShortcut(QKeySequence(Qt::Key_F), win);
+  QSignalSpy clientSpy(&clientShortcut, &QShortcut::activated);
+
+  QTest::keyClick(win, Qt::Key_Escape, Qt::ShiftModifier);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Ignore);
+  // the client gets its keys, and no hinting happens
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(clientSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Ignore);
+  // focus changes don't end Ignore mode
+  buttons.at(2)->setFocus();
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Ignore);
+
+  QTest::keyClick(win, Qt::Key_Escape, Qt::ShiftModifier);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(clientSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+}
+
+void EventFilterTest::testIgnoreWindowClasses() {
+  Controller::settings.ignoreWindowClasses = QStringList({"QWidget"});
+  Controller::createController();
+  Controller::settings.ignoreWindowClasses.clear();
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Ignore);
+}
+
+// "f" waits for the "y" of "fy". A hint key in its place starts hinting and is
+// the first key of the code rather than going to the client.
+void EventFilterTest::testTypeAheadAfterPendingBinding() {
+  QKeySequence yank = Controller::settings.keymap.yank;
+  Controller::settings.keymap.yank = QKeySequence(Qt::Key_F, Qt::Key_Y);
+  Controller::createController();
+  Controller::settings.keymap.yank = yank;
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  QShortcut clientShortcut(QKeySequence(Qt::Key_A), win);
+  QSignalSpy clientSpy(&clientShortcut, &QShortcut::activated);
+  QSignalSpy clickedSpy(buttons.at(0), &QPushButton::clicked);
+
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QTest::keyClicks(win, "AA");
+  QCOMPARE(clientSpy.count(), 0);
+  QCOMPARE(clickedSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+}
+
+// A count with no binding after it reaches the shortcuts of the client after
+// all, followed by the key which ended it
+void EventFilterTest::testCountGivenBack() {
+  Controller::createController();
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  QString triggered;
+  QShortcut oneShortcut(QKeySequence(Qt::Key_1), win);
+  connect(&oneShortcut, &QShortcut::activated, [&] { triggered += "1"; });
+  QShortcut xShortcut(QKeySequence(Qt::Key_X), win);
+  connect(&xShortcut, &QShortcut::activated, [&] { triggered += "X"; });
+
+  QTest::keyClick(win, Qt::Key_1);
+  QCOMPARE(triggered, "");
+  QTest::keyClick(win, Qt::Key_X);
+  QCOMPARE(triggered, "1X");
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+
+  // likewise once the count times out
+  QTest::keyClick(win, Qt::Key_1);
+  QTest::qWait(Controller::settings.keySequenceTimeoutMs + 100);
+  QCOMPARE(triggered, "1X1");
+
+  // a count which ends in a binding stays with Tetradactyl
+  QTest::keyClick(win, Qt::Key_1);
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QCOMPARE(triggered, "1X1");
+}
+
+void EventFilterTest::benchmarkNonKeyEvents_data() {
+  QTest::addColumn<bool>("withController");
+  QTest::addColumn<bool>("ignore");
+  QTest::newRow("without controller") << false << false;
+  QTest::newRow("with controller") << true << false;
+  QTest::newRow("in ignore mode") << true << true;
+}
+
+// Cost of dispatching events the client handles itself, such as timers. With
+// the controller they pass one application filter, which returns at once for
+// them, so the cost should be close to that without. In Ignore mode the
+// application has no filter of Tetradactyl left at all.
+void EventFilterTest::benchmarkNonKeyEvents() {
+  QFETCH(bool, withController);
+  QFETCH(bool, ignore);
+  if (withController)
+    Controller::createController();
+  if (ignore)
+    Controller::instance()->windows().at(0)->setControllerMode(
+        Tetradactyl::Ignore);
+  QPushButton *button = buttons.at(0);
+  QEvent ev(QEvent::User);
+  QBENCHMARK {
+    for (int i = 0; i != EVENTS_PER_ITERATION; ++i)
+      QCoreApplication::sendEvent(button, &ev);
+  }
+}
+
+QTEST_MAIN(EventFilterTest);
+#include "eventfilter_test.moc"
@@ -3,6 +3,7 @@
 
 #include <QMenu>
 #include <QMenuBar>
+#include <QPointer>
 
 #include <qt/hint.h>
 #include <qt/overlay.h>
@@ -60,25 +61,39 @@ void MenuBarActionTest::cleanup() {
 }
 
 void MenuBarActionTest::overlaysAddedTest() {
-  for (auto menu : allMenus) {
-    Overlay *menuOverlay = windowController->findOverlayForWidget(menu);
-    QTRY_VERIFY2(menuOverlay != nullptr && menuOverlay != overlay,
-                 "QMenu has overlay which isn't the window's overlay");
-    QTRY_VERIFY2(menuOverlay->statusIndicator() == nullptr,
-                 "QMenu overlay has no status indicator label");
-  }
+  for (auto menu : allMenus)
+    QVERIFY2(windowController->findOverlayForWidget(menu) == nullptr,
+             "QMenu overlays aren't created up front");
+
+  QTest::keyClicks(win, "ma");
+  Overlay *menuOverlay = windowController->findOverlayForWidget(fileMenu);
+  QVERIFY2(menuOverlay != nullptr && menuOverlay != overlay,
+           "QMenu has overlay which isn't the window's overlay");
+  QVERIFY2(menuOverlay->statusIndicator() == nullptr,
+           "QMenu overlay has no status indicator label");
+
+  QTest::keyClick(win, Qt::Key_Escape);
+  QCOMPARE(windowController->findOverlayForWidget(fileMenu), nullptr);
+  QCOMPARE(windowController->pooledOverlays(), 1);
+
+  // the pooled overlay is reused by the next menu
+  fileMenu->close();
+  QTRY_VERIFY(!fileMenu->isVisible());
+  QTest::keyClicks(win, "ma");
+  QCOMPARE(windowController->findOverlayForWidget(fileMenu), menuOverlay);
+  QCOMPARE(windowController->pooledOverlays(), 0);
 }
 
 void MenuBarActionTest::stepChangeMakesOverlaysInvisibleTest() {
   QTest::keyClicks(win, "m");
-  Overlay *fileMenuOverlay =
-      windowController->findOverlayForWidget(menuBar->findChild<QMenu *>());
-  QVERIFY(fileMenuOverlay != nullptr);
   QCOMPARE_GT(overlay->visibleHints().length(), 0);
-  QCOMPARE(fileMenuOverlay->hints().length(), 0);
 
   QTest::keyClicks(win, "a");
+  Overlay *fileMenuOverlay =
+      windowController->findOverlayForWidget(menuBar->findChild<QMenu *>());
+  QVERIFY(fileMenuOverlay != nullptr);
   QCOMPARE_GT(fileMenuOverlay->hints().length(), 0);
+  QCOMPARE(overlay->visibleHints().length(), 0);
 }
 
 void MenuBarActionTest::basicTwoStepMenuBarActionAcceptedTest() {
@@ -186,15 +201,15 @@ void MenuBarActionTest::tracerInMenuTest() {
   QMenu *fileMenu =
       qobject_cast<QMenu *>(windowController->activeOverlay()->parentWidget());
   QCOMPARE(fileMenu->title(), "&File");
+  QPointer<Overlay> menuOverlay = windowController->activeOverlay();
   QTest::keyClicks(win, "d");
   // File menu item accepted
   QTest::qWait(100);
-  QList<HintLabel *> remainingHints = fileMenu->findChildren<HintLabel *>();
-  QCOMPARE(remainingHints.length(), 1);
-  HintLabel *acceptedHint = remainingHints.at(0);
-  QVERIFY(acceptedHint->isSelected());
-  QTest::qWait(500);
   QCOMPARE(fileMenu->findChildren<HintLabel *>().length(), 0);
+  QVERIFY(menuOverlay);
+  QVERIFY(menuOverlay->hasTracer());
+  QTest::qWait(500);
+  QVERIFY(!menuOverlay->hasTracer());
 }
 
 } // namespace Tetradactyl
@@ -0,0 +1,179 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+
+#include <QAction>
+#include <QMenu>
+#include <QPushButton>
+#include <QStandardItemModel>
+#include <QTabWidget>
+#include <QTreeView>
+#include <QVBoxLayout>
+#include <QWidget>
+#include <QtTest>
+
+#include "common.h"
+#include <qt/objectpath.h>
+
+#define NUM_BUTTONS 10
+
+using Tetradactyl::ObjectPathCache;
+using Tetradactyl::ObjectPathTarget;
+
+// Object paths of widgets and pseudo-widgets resolve back to them, through the
+// cache once resolved
+class ObjectPathTest : public QObject {
+  Q_OBJECT
+private slots:
+  void init();
+  void cleanup();
+  void testWidgetPaths();
+  void testPseudoWidgetPaths();
+  void testDestroyedWidget();
+  void testWindowScope();
+  void benchmarkResolve_data();
+  void benchmarkResolve();
+
+private:
+  QWidget *win;
+  QList<QPushButton *> buttons;
+  QTabWidget *tabWidget;
+  QTreeView *treeView;
+  QStandardItemModel *model;
+  QMenu *menu;
+};
+
+void ObjectPathTest::init() {
+  win = new QWidget;
+  QVBoxLayout *layout = new QVBoxLayout(win);
+  buttons.clear();
+  for (int i = 0; i != NUM_BUTTONS; ++i) {
+    QPushButton *button = new QPushButton(QString("Button %1").arg(i), win);
+    buttons.append(button);
+    layout->addWidget(button);
+  }
+  buttons.at(0)->setObjectName("refresh");
+  tabWidget = new QTabWidget(win);
+  for (int i = 0; i != 3; ++i)
+    tabWidget->addTab(new QWidget, QString("Tab %1").arg(i));
+  layout->addWidget(tabWidget);
+  model = new QStandardItemModel(win);
+  for (int i = 0; i != 3; ++i) {
+    QStandardItem *item = new QStandardItem(QString("Item %1").arg(i));
+    item->appendRow(new QStandardItem(QString("Child %1").arg(i)));
+    model->appendRow(item);
+  }
+  treeView = new QTreeView(win);
+  treeView->setModel(model);
+  layout->addWidget(treeView);
+  menu = new QMenu(win);
+  menu->addAction("&Open");
+  menu->addAction("Save")->setObjectName("saveAction");
+  ObjectPathCache::instance()->clear();
+  win->show();
+  QVERIFY(QTest::qWaitForWindowExposed(win));
+}
+
+void ObjectPathTest::cleanup() {
+  delete win;
+  ObjectPathCache::instance()->clear();
+}
+
+void ObjectPathTest::testWidgetPaths() {
+  ObjectPathCache *cache = ObjectPathCache::instance();
+  QCOMPARE(Tetradactyl::widgetPath(buttons.at(0)),
+           "QWidget/QPushButton#refresh");
+  QCOMPARE(Tetradactyl::widgetPath(buttons.at(3)), "QWidget/QPushButton[3]");
+  for (QPushButton *button : buttons)
+    QCOMPARE(cache->resolve(Tetradactyl::widgetPath(button)).widget, button);
+  QCOMPARE(cache->size(), NUM_BUTTONS);
+  // resolved again from the cache
+  QCOMPARE(cache->resolve(Tetradactyl::widgetPath(buttons.at(3))).widget,
+           buttons.at(3));
+  QCOMPARE(cache->size(), NUM_BUTTONS);
+  QVERIFY(cache->resolve("QWidget/QPushButton[42]").widget == nullptr);
+  QVERIFY(cache->resolve("QMainWindow/QPushButton[0]").widget == nullptr);
+}
+
+void ObjectPathTest::testPseudoWidgetPaths() {
+  ObjectPathCache *cache = ObjectPathCache::instance();
+  QTabBar *bar = tabWidget->tabBar();
+  ObjectPathTarget tab = cache->resolve(Tetradactyl::tabPath(bar, 2));
+  QCOMPARE(tab.widget, bar);
+  QCOMPARE(tab.tab, 2);
+  QVERIFY(cache->resolve(Tetradactyl::tabPath(bar, 3)).widget == nullptr);
+
+  QModelIndex child = model->index(0, 0, model->index(1, 0));
+  QString indexPath = Tetradactyl::modelIndexPath(treeView, child);
+  QVERIFY(indexPath.endsWith("|index:1,0/0,0"));
+  ObjectPathTarget item = cache->resolve(indexPath);
+  QCOMPARE(item.widget, treeView);
+  QCOMPARE(item.index, child);
+
+  for (QAction *action : menu->actions()) {
+    ObjectPathTarget target =
+        cache->resolve(Tetradactyl::actionPath(menu, action));
+    QCOMPARE(target.widget, menu);
+    QCOMPARE(target.action, action);
+  }
+  QVERIFY(Tetradactyl::actionPath(menu, menu->actions().at(0))
+              .endsWith("|action:Open"));
+  QVERIFY(Tetradactyl::actionPath(menu, menu->actions().at(1))
+              .endsWith("|action:saveAction"));
+}
+
+void ObjectPathTest::testDestroyedWidget() {
+  ObjectPathCache *cache = ObjectPathCache::instance();
+  QString path = Tetradactyl::widgetPath(buttons.at(0));
+  QCOMPARE(cache->resolve(path).widget, buttons.at(0));
+  delete buttons.takeFirst();
+  QVERIFY(cache->resolve(path).widget == nullptr);
+
+  QPushButton *button = new QPushButton("Refresh", win);
+  button->setObjectName("refresh");
+  QCOMPARE(cache->resolve(path).widget, button);
+}
+
+// Windows of the same path are told apart by the scope, or else by the rest
+// of the path
+void ObjectPathTest::testWindowScope() {
+  ObjectPathCache *cache = ObjectPathCache::instance();
+  QWidget other;
+  QVBoxLayout *layout = new QVBoxLayout(&other);
+  QList<QPushButton *> otherButtons;
+  for (int i = 0; i != NUM_BUTTONS; ++i) {
+    otherButtons.append(new QPushButton(QString("Other %1").arg(i), &other));
+    layout->addWidget(otherButtons.last());
+  }
+  other.show();
+  QVERIFY(QTest::qWaitForWindowExposed(&other));
+
+  QString path = Tetradactyl::widgetPath(buttons.at(3));
+  QCOMPARE(path, Tetradactyl::widgetPath(otherButtons.at(3)));
+  QCOMPARE(cache->resolve(path, win).widget, buttons.at(3));
+  QCOMPARE(cache->resolve(path, &other).widget, otherButtons.at(3));
+  QCOMPARE(cache->resolve(path, win).widget, buttons.at(3));
+  QString tabPath = Tetradactyl::widgetPath(tabWidget);
+  QVERIFY(cache->resolve(tabPath, &other).widget == nullptr);
+  QCOMPARE(cache->resolve(tabPath).widget, tabWidget);
+}
+
+void ObjectPathTest::benchmarkResolve_data() {
+  QTest::addColumn<bool>("cached");
+  QTest::newRow("uncached") << false;
+  QTest::newRow("cached") << true;
+}
+
+// Resolving a cached path is a hash lookup, and an uncached one walks the
+// children of each ancestor
+void ObjectPathTest::benchmarkResolve() {
+  QFETCH(bool, cached);
+  ObjectPathCache *cache = ObjectPathCache::instance();
+  QString path = Tetradactyl::widgetPath(buttons.at(NUM_BUTTONS - 1));
+  QBENCHMARK {
+    if (!cached)
+      cache->clear();
+    cache->resolve(path);
+  }
+}
+
+QTEST_MAIN(ObjectPathTest);
+#include "objectpath_test.moc"
@@ -0,0 +1,129 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+
+#include <QList>
+#include <QPaintEvent>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QWidget>
+#include <QtTest>
+
+#include "common.h"
+#include <qt/commandline.h>
+#include <qt/controller.h>
+#include <qt/hint.h>
+#include <qt/overlay.h>
+
+#define NUM_BUTTONS 10
+
+using Tetradactyl::Controller;
+using Tetradactyl::HintLabel;
+using Tetradactyl::Overlay;
+using Tetradactyl::OverlaySurface;
+using Tetradactyl::WindowController;
+
+// Stand-in for an expensive client widget, e.g. a chart or a canvas
+class PaintCounter : public QWidget {
+  Q_OBJECT
+public:
+  PaintCounter() : QWidget(), paints(0) {}
+  int paints;
+
+protected:
+  void paintEvent(QPaintEvent *ev) override {
+    paints++;
+    QWidget::paintEvent(ev);
+  }
+};
+
+class OverlaySurfaceTest : public QObject {
+  Q_OBJECT
+private slots:
+  void initTestCase();
+  void cleanupTestCase();
+  void init();
+  void cleanup();
+  void testHintsOnSurface();
+  void testHintingDoesNotRepaintClient();
+
+private:
+  PaintCounter *win;
+  const Controller *controller;
+  WindowController *windowController;
+  Overlay *overlay;
+};
+
+void OverlaySurfaceTest::initTestCase() {
+  Controller::settings.nativeOverlaySurface = true;
+}
+
+void OverlaySurfaceTest::cleanupTestCase() {
+  Controller::settings.nativeOverlaySurface = false;
+}
+
+void OverlaySurfaceTest::init() {
+  win = new PaintCounter;
+  QVBoxLayout *layout = new QVBoxLayout(win);
+  for (int i = 0; i != NUM_BUTTONS; ++i)
+    layout->addWidget(new QPushButton(QString("Button %1").arg(i), win));
+  Tetradactyl::useFixedLengthHintCodes();
+  Controller::createController();
+  controller = Controller::instance();
+  windowController = controller->windows().at(0);
+  overlay = windowController->overlays().at(0);
+  Tetradactyl::waitForWindowActiveOrFail(win);
+}
+
+void OverlaySurfaceTest::cleanup() {
+  delete controller;
+  delete win;
+}
+
+void OverlaySurfaceTest::testHintsOnSurface() {
+  QTest::keyClick(win, Qt::Key_F);
+  QCOMPARE(overlay->hints().length(), NUM_BUTTONS);
+  OverlaySurface *surface =
+      qobject_cast<OverlaySurface *>(overlay->hints().at(0)->parentWidget());
+  QVERIFY2(surface != nullptr, "Hints are children of the surface");
+  QVERIFY(surface->isWindow());
+  QVERIFY(surface->isVisible());
+  QCOMPARE(surface->geometry(),
+           QRect(win->mapToGlobal(QPoint(0, 0)), win->size()));
+  QCOMPARE(overlay->statusIndicator()->parentWidget(),
+           static_cast<QWidget *>(surface));
+  // the overlay in the host is only shown for the command line
+  QVERIFY(!overlay->isVisible());
+  QTest::keyClick(win, Qt::Key_Escape);
+  QTest::keyClick(win, Qt::Key_Colon);
+  QVERIFY(overlay->isVisible());
+  QVERIFY(overlay->commandLine()->isVisible());
+  overlay->commandLine()->setOpened(false);
+  QVERIFY(!overlay->isVisible());
+  QTest::keyClick(win, Qt::Key_F);
+  QTest::keyClick(win, Qt::Key_Escape);
+  QCOMPARE(overlay->hints().length(), 0);
+  win->hide();
+  QVERIFY2(!surface->isVisible(), "Surface is hidden along with the host");
+}
+
+void OverlaySurfaceTest::testHintingDoesNotRepaintClient() {
+  // let pending paints of the freshly shown window settle
+  QTest::qWait(50);
+  int paintsBefore = win->paints;
+
+  QTest::keyClick(win, Qt::Key_F);
+  QTRY_COMPARE(overlay->hints().length(), NUM_BUTTONS);
+  QTest::qWait(50);
+  QCOMPARE(win->paints, paintsBefore);
+
+  // narrowing hints down updates only the surface
+  QTest::keyClick(win, Qt::Key_A);
+  QTest::qWait(50);
+  QCOMPARE(win->paints, paintsBefore);
+
+  QTest::keyClick(win, Qt::Key_Escape);
+  QTest::qWait(50);
+  QCOMPARE(win->paints, paintsBefore);
+}
+
+QTEST_MAIN(OverlaySurfaceTest);
+#include "overlaysurface_test.moc"
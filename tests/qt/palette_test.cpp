@@ -0,0 +1,199 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+
+#include <QAction>
+#include <QApplication>
+#include <QMainWindow>
+#include <QMenu>
+#include <QMenuBar>
+#include <QSignalSpy>
+#include <QToolBar>
+#include <QtTest>
+
+#include "common.h"
+#include <qt/commandline.h>
+#include <qt/controller.h>
+#include <qt/overlay.h>
+#include <qt/palette.h>
+
+#define NUM_MENUS 50
+#define ACTIONS_PER_MENU 100
+
+using Tetradactyl::ActionIndex;
+using Tetradactyl::CommandLine;
+using Tetradactyl::Controller;
+using Tetradactyl::WindowController;
+
+// Actions of menus, submenus and tool bars are found by their menu path, text
+// and shortcut, and triggered without opening the menus
+class PaletteTest : public QObject {
+  Q_OBJECT
+private slots:
+  void init();
+  void cleanup();
+  void testMenuPaths();
+  void testIncrementalUpdates();
+  void testUpdatesAfterIgnore();
+  void testTriggerFromCommandLine();
+  void testPaletteCommand();
+  void benchmarkSearch_data();
+  void benchmarkSearch();
+
+private:
+  QString firstMatch(const QString &query);
+
+  QMainWindow *win;
+  QAction *open;
+  QAction *save;
+  QAction *project;
+  QAction *print;
+  QAction *zoom;
+};
+
+// The actions are made after the controller, so that they're indexed through
+// their QActionEvents
+void PaletteTest::init() {
+  win = new QMainWindow;
+  win->setCentralWidget(new QWidget);
+  win->show();
+  QVERIFY(QTest::qWaitForWindowActive(win));
+  Controller::createController();
+  QMenu *file = win->menuBar()->addMenu("&File");
+  open = file->addAction("&Open");
+  open->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_O));
+  save = file->addAction("&Save");
+  QMenu *recent = file->addMenu("&Recent");
+  project = recent->addAction("Project A");
+  print = file->addAction("&Print");
+  print->setEnabled(false);
+  zoom = win->addToolBar("View")->addAction("Zoom In");
+}
+
+void PaletteTest::cleanup() {
+  delete Controller::instance();
+  delete win;
+}
+
+QString PaletteTest::firstMatch(const QString &query) {
+  QVector<int> results = ActionIndex::instance()->search(query, win, 1);
+  if (results.isEmpty())
+    return QString();
+  return ActionIndex::instance()->text(results.at(0));
+}
+
+void PaletteTest::testMenuPaths() {
+  QCOMPARE(firstMatch("save"), QString("File > Save"));
+  QCOMPARE(firstMatch("prja"), QString("File > Recent > Project A"));
+  QVERIFY(firstMatch("ctrl+o").startsWith("File > Open"));
+  QCOMPARE(firstMatch("zoom"), QString("Zoom In"));
+  // disabled actions and menus themselves aren't found
+  QCOMPARE(firstMatch("print"), QString());
+  QCOMPARE(firstMatch("recent"), QString("File > Recent > Project A"));
+  // nor actions of other windows
+  QWidget other;
+  QCOMPARE(ActionIndex::instance()->search("save", &other, 1).length(), 0);
+}
+
+void PaletteTest::testIncrementalUpdates() {
+  QCOMPARE(firstMatch("save"), QString("File > Save"));
+  QMenu *edit = win->menuBar()->addMenu("&Edit");
+  QAction *undo = edit->addAction("&Undo");
+  QCOMPARE(firstMatch("undo"), QString("Edit > Undo"));
+  undo->setText("Undo Typing");
+  QCOMPARE(firstMatch("undo"), QString("Edit > Undo Typing"));
+  edit->setTitle("&Change");
+  QCOMPARE(firstMatch("undo"), QString("Change > Undo Typing"));
+  print->setEnabled(true);
+  QCOMPARE(firstMatch("print"), QString("File > Print"));
+  edit->removeAction(undo);
+  QCOMPARE(firstMatch("undo"), QString());
+}
+
+// Action events go unseen while every window is ignored, and are made up for
+// once one isn't
+void PaletteTest::testUpdatesAfterIgnore() {
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  QCOMPARE(firstMatch("save"), QString("File > Save"));
+  windowController->setControllerMode(Tetradactyl::Ignore);
+  save->setText("Save &All");
+  windowController->setControllerMode(Tetradactyl::Normal);
+  QCOMPARE(firstMatch("save"), QString("File > Save All"));
+}
+
+void PaletteTest::testTriggerFromCommandLine() {
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  CommandLine *prompt = windowController->mainOverlay()->commandLine();
+  QSignalSpy projectSpy(project, &QAction::triggered);
+  QSignalSpy saveSpy(save, &QAction::triggered);
+
+  QTest::keyClick(win, Qt::Key_Colon);
+  QTest::keyClicks(prompt, ">proj");
+  QVERIFY(prompt->actionPalette() != nullptr);
+  QVERIFY(prompt->actionPalette()->isVisible());
+  QCOMPARE(prompt->actionPalette()->selectedAction(), project);
+  QTest::keyClick(prompt, Qt::Key_Return);
+  QTRY_COMPARE(projectSpy.count(), 1);
+  QVERIFY(QApplication::activePopupWidget() == nullptr);
+  QVERIFY(!prompt->actionPalette()->isVisible());
+
+  // the best match is selected first, and up selects the next best
+  prompt->openPalette();
+  QTest::keyClicks(prompt, "e");
+  QCOMPARE(prompt->actionPalette()->results().length(), 3);
+  QCOMPARE(prompt->actionPalette()->selectedAction(), save);
+  QTest::keyClick(prompt, Qt::Key_Up);
+  QCOMPARE(prompt->actionPalette()->selectedAction(), open);
+  QTest::keyClick(prompt, Qt::Key_Down);
+  QTest::keyClick(prompt, Qt::Key_Return);
+  QTRY_COMPARE(saveSpy.count(), 1);
+  QCOMPARE(projectSpy.count(), 1);
+}
+
+// :palette opens the prompt again once it's closed, on the palette
+void PaletteTest::testPaletteCommand() {
+  WindowController *windowController = Controller::instance()->windows().at(0);
+  CommandLine *prompt = windowController->mainOverlay()->commandLine();
+  QSignalSpy openSpy(open, &QAction::triggered);
+
+  QTest::keyClick(win, Qt::Key_Colon);
+  QTest::keyClicks(prompt, "palette");
+  QTest::keyClick(prompt, Qt::Key_Return);
+  QTRY_VERIFY(prompt->isOpen());
+  QTest::qWait(50);
+  QVERIFY(prompt->isOpen());
+  QVERIFY(prompt->actionPalette() != nullptr);
+  QVERIFY(prompt->actionPalette()->isVisible());
+  QCOMPARE(prompt->text(), QString(">"));
+  QTest::keyClicks(prompt, "open");
+  QTest::keyClick(prompt, Qt::Key_Return);
+  QTRY_COMPARE(openSpy.count(), 1);
+  QVERIFY(!prompt->isOpen());
+}
+
+void PaletteTest::benchmarkSearch_data() {
+  QTest::addColumn<QString>("query");
+  QTest::newRow("one key") << "m";
+  QTest::newRow("several keys") << "menu 7 act 42";
+  QTest::newRow("no match") << "xqz";
+}
+
+// Searching thousands of actions, as typed key by key. The index isn't made
+// again between searches.
+void PaletteTest::benchmarkSearch() {
+  QFETCH(QString, query);
+  for (int i = 0; i != NUM_MENUS; ++i) {
+    QMenu *menu = win->menuBar()->addMenu(QString("Menu %1").arg(i));
+    for (int j = 0; j != ACTIONS_PER_MENU; ++j)
+      menu->addAction(QString("Action %1").arg(j));
+  }
+  ActionIndex *index = ActionIndex::instance();
+  index->refresh();
+  QVERIFY(index->size() >= NUM_MENUS * ACTIONS_PER_MENU);
+  QBENCHMARK {
+    for (int i = 1; i <= query.length(); ++i)
+      index->search(query.left(i), win, 10);
+    index->search(QString(), win, 10);
+  }
+}
+
+QTEST_MAIN(PaletteTest);
+#include "palette_test.moc"
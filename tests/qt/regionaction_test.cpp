@@ -0,0 +1,120 @@
+// Copyright 2023 Paweł Sacawa. All rights reserved.
+
+#include <QPushButton>
+#include <QSignalSpy>
+#include <QSplitter>
+#include <QVBoxLayout>
+#include <QWidget>
+#include <QtTest>
+
+#include "common.h"
+#include <qt/controller.h>
+#include <qt/hint.h>
+#include <qt/overlay.h>
+
+#define BUTTONS_PER_PANE 3
+
+using Tetradactyl::Controller;
+using Tetradactyl::HintLabel;
+using Tetradactyl::Overlay;
+using Tetradactyl::WindowController;
+
+// Region-first hinting over the two panes of a splitter
+class RegionActionTest : public QObject {
+  Q_OBJECT
+private slots:
+  void init();
+  void cleanup();
+  void testRegionThenTarget();
+  void testCancelInRegion();
+  void testEmptyRegion();
+
+private:
+  QWidget *win;
+  QList<QWidget *> panes;
+  QList<QPushButton *> buttons;
+  WindowController *windowController;
+  Overlay *overlay;
+};
+
+void RegionActionTest::init() {
+  win = new QWidget;
+  QVBoxLayout *layout = new QVBoxLayout(win);
+  QSplitter *splitter = new QSplitter(win);
+  layout->addWidget(splitter);
+  panes.clear();
+  buttons.clear();
+  for (int i = 0; i != 2; ++i) {
+    QWidget *pane = new QWidget;
+    QVBoxLayout *paneLayout = new QVBoxLayout(pane);
+    for (int j = 0; j != BUTTONS_PER_PANE; ++j) {
+      QPushButton *button =
+          new QPushButton(QString("Button %1.%2").arg(i).arg(j), pane);
+      buttons.append(button);
+      paneLayout->addWidget(button);
+    }
+    panes.append(pane);
+    splitter->addWidget(pane);
+  }
+  Tetradactyl::useFixedLengthHintCodes();
+  win->show();
+  QVERIFY(QTest::qWaitForWindowActive(win));
+  Controller::createController();
+  windowController = Controller::instance()->windows().at(0);
+  overlay = windowController->overlays().at(0);
+}
+
+void RegionActionTest::cleanup() {
+  delete Controller::instance();
+  delete win;
+}
+
+void RegionActionTest::testRegionThenTarget() {
+  QSignalSpy clickedSpy(buttons.at(BUTTONS_PER_PANE + 2),
+                        &QPushButton::clicked);
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_R);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QCOMPARE(overlay->hints().length(), 2);
+  QCOMPARE(overlay->hints().at(1)->target, panes.at(1));
+
+  // only the buttons of the chosen pane are hinted next
+  QTest::keyClick(win, Qt::Key_S);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Hint);
+  QCOMPARE(overlay->hints().length(), BUTTONS_PER_PANE);
+  for (HintLabel *hint : overlay->hints())
+    QCOMPARE(hint->target->parentWidget(), panes.at(1));
+
+  QTest::keyClick(win, Qt::Key_D);
+  QCOMPARE(clickedSpy.count(), 1);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+}
+
+void RegionActionTest::testCancelInRegion() {
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_R);
+  QTest::keyClick(win, Qt::Key_A);
+  QCOMPARE(overlay->hints().length(), BUTTONS_PER_PANE);
+  QTest::keyClick(win, Qt::Key_Escape);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QCOMPARE(overlay->hints().length(), 0);
+}
+
+// A region with nothing to hint ends the action
+void RegionActionTest::testEmptyRegion() {
+  QWidget *empty = new QWidget;
+  empty->setMinimumSize(50, 50);
+  qobject_cast<QSplitter *>(panes.at(0)->parentWidget())->addWidget(empty);
+  empty->show();
+  QTest::keyClick(win, Qt::Key_G);
+  QTest::keyClick(win, Qt::Key_R);
+  QCOMPARE(overlay->hints().length(), 3);
+  QCOMPARE(overlay->hints().at(2)->target, empty);
+  QTest::keyClick(win, Qt::Key_D);
+  QCOMPARE(windowController->controllerMode(), Tetradactyl::Normal);
+  QCOMPARE(overlay->hints().length(), 0);
+  QVERIFY(windowController->currentAction() == nullptr);
+}
+
+QTEST_MAIN(RegionActionTest);
+#include "regionaction_test.moc"